@@ -1787,6 +1787,48 @@ ctx_clear_err(PyObject *_self, PyObject *args)
 	Py_RETURN_NONE;
 }
 
+PyDoc_STRVAR(ctx_set_xlat_cache__doc__,
+"CTX.set_xlat_cache(size)\n\
+\n\
+Set the number of cached translations. Zero disables the cache.");
+
+static PyObject *
+ctx_set_xlat_cache(PyObject *_self, PyObject *args, PyObject *kwargs)
+{
+	ctx_object *self = (ctx_object*)_self;
+	static char *keywords[] = {"size", NULL};
+	Py_ssize_t size;
+	addrxlat_status status;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "n:set_xlat_cache",
+					 keywords, &size))
+		return NULL;
+	if (size < 0) {
+		PyErr_SetString(PyExc_ValueError,
+				"Cache size must not be negative");
+		return NULL;
+	}
+
+	status = addrxlat_ctx_set_xlat_cache(self->ctx, size);
+	if (status != ADDRXLAT_OK)
+		return raise_exception(self->ctx, status);
+	Py_RETURN_NONE;
+}
+
+PyDoc_STRVAR(ctx_flush_xlat_cache__doc__,
+"CTX.flush_xlat_cache()\n\
+\n\
+Discard all cached translations.");
+
+static PyObject *
+ctx_flush_xlat_cache(PyObject *_self, PyObject *args)
+{
+	ctx_object *self = (ctx_object*)_self;
+
+	addrxlat_ctx_flush_xlat_cache(self->ctx);
+	Py_RETURN_NONE;
+}
+
 PyDoc_STRVAR(ctx_get_err__doc__,
 "CTX.get_err() -> error string\n\
 \n\
@@ -1950,6 +1992,11 @@ static PyMethodDef ctx_methods[] = {
 	  ctx_clear_err__doc__ },
 	{ "get_err", ctx_get_err, METH_NOARGS,
 	  ctx_get_err__doc__ },
+	{ "set_xlat_cache", (PyCFunction)ctx_set_xlat_cache,
+	  METH_VARARGS | METH_KEYWORDS,
+	  ctx_set_xlat_cache__doc__ },
+	{ "flush_xlat_cache", ctx_flush_xlat_cache, METH_NOARGS,
+	  ctx_flush_xlat_cache__doc__ },
 
 	/* Callbacks */
 	{ "cb_sym", ctx_next_cb_sym, METH_VARARGS,
@@ -3237,7 +3284,7 @@ PyDoc_STRVAR(lookupmeth_endoff__doc__,
 "max address offset inside each object");
 
 PyDoc_STRVAR(lookupmeth_tbl__doc__,
-"lookup table");
+"lookup table (sorted by original address)");
 
 static PyObject *
 lookupmeth_get_tbl(PyObject *_self, void *data)
@@ -3269,6 +3316,13 @@ lookupmeth_get_tbl(PyObject *_self, void *data)
 	return result;
 }
 
+static int
+lookup_elem_cmp(const void *a, const void *b)
+{
+	const addrxlat_lookup_elem_t *ea = a, *eb = b;
+	return ea->orig != eb->orig ? (ea->orig < eb->orig ? -1 : 1) : 0;
+}
+
 static int
 lookupmeth_set_tbl(PyObject *_self, PyObject *value, void *data)
 {
@@ -3331,6 +3385,9 @@ lookupmeth_set_tbl(PyObject *_self, PyObject *value, void *data)
 		Py_DECREF(pair);
 	}
 
+	/* The table is searched with binary search. */
+	qsort(tbl, n, sizeof(addrxlat_lookup_elem_t), lookup_elem_cmp);
+
  out:
 	self->meth.param.lookup.nelem = n;
 	if (self->meth.param.lookup.tbl)
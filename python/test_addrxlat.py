@@ -770,6 +770,23 @@ class TestTranslation(unittest.TestCase):
         addr.conv(addrxlat.KVADDR, self.ctx, self.sys)
         self.assertEqual(addr, addrxlat.FullAddress(addrxlat.KVADDR, 0x1345))
 
+    def test_xlat_cache(self):
+        "KV -> KPHYS using the translation cache"
+        self.ctx.set_xlat_cache(16)
+        addr = addrxlat.FullAddress(addrxlat.KVADDR, 0x6502)
+        addr.conv(addrxlat.KPHYSADDR, self.ctx, self.sys)
+        self.assertEqual(addr, addrxlat.FullAddress(addrxlat.KPHYSADDR, 0xc002))
+        # Another address in the same page
+        addr = addrxlat.FullAddress(addrxlat.KVADDR, 0x65ff)
+        addr.conv(addrxlat.KPHYSADDR, self.ctx, self.sys)
+        self.assertEqual(addr, addrxlat.FullAddress(addrxlat.KPHYSADDR, 0xc0ff))
+        # Cached translations must not survive a method change
+        meth = addrxlat.LinearMethod(addrxlat.KPHYSADDR, 0x1000)
+        self.sys.set_meth(addrxlat.SYS_METH_PGT, meth)
+        addr = addrxlat.FullAddress(addrxlat.KVADDR, 0x6502)
+        addr.conv(addrxlat.KPHYSADDR, self.ctx, self.sys)
+        self.assertEqual(addr, addrxlat.FullAddress(addrxlat.KPHYSADDR, 0x7502))
+
     def test_op_direct(self):
         "Operator using directmap"
         class hexop(addrxlat.Operator):
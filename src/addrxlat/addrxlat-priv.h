@@ -112,6 +112,43 @@ struct read_cache {
 INTERNAL_DECL(void, bury_cache_buffer,
 	      (struct read_cache *cache, const addrxlat_fulladdr_t *addr));
 
+/** Page shift used to index the translation cache. */
+#define XLAT_CACHE_SHIFT	12
+
+/** Translation cache entry.
+ * An entry covers a block of source addresses which are all translated
+ * by adding the same offset, i.e. the final page of a page table walk,
+ * clipped to the translation map ranges used for the translation.
+ */
+struct xlat_cache_ent {
+	/** Translation system generation, or zero if unused. */
+	unsigned long gen;
+
+	/** Capabilities of the requested operation. */
+	unsigned long caps;
+
+	/** Source address space. */
+	addrxlat_addrspace_t as;
+
+	/** First source address in the block. */
+	addrxlat_addr_t addr;
+
+	/** Offset of the last source address in the block. */
+	addrxlat_addr_t endoff;
+
+	/** Translation of @c addr. */
+	addrxlat_fulladdr_t target;
+};
+
+/** Translation result cache. */
+struct xlat_cache {
+	/** Number of slots minus one (slot index mask). */
+	size_t mask;
+
+	/** Cache slots, or @c NULL if the cache is disabled. */
+	struct xlat_cache_ent *slot;
+};
+
 /**  Representation of address translation.
  *
  * This structure contains all internal state needed to perform address
@@ -142,11 +179,24 @@ struct _addrxlat_ctx {
 	/** Read cache. */
 	struct read_cache cache;
 
+	/** Translation result cache. */
+	struct xlat_cache xlat;
+
+	/** Last table searched by @ref ADDRXLAT_LOOKUP. */
+	const addrxlat_lookup_elem_t *lookup_tbl;
+
+	/** Index of the last matching element in @c lookup_tbl. */
+	size_t lookup_hint;
+
 	/** Error message buffer.
 	 * This must be the last member. */
 	kdump_errmsg_t err;
 };
 
+/* step */
+
+INTERNAL_DECL(void, lookup_sort, (addrxlat_param_lookup_t *lookup));
+
 /* utils */
 
 INTERNAL_DECL(addrxlat_status, read32,
@@ -223,6 +273,9 @@ struct _addrxlat_map {
 
 	/** Actual range definitions. */
 	addrxlat_range_t *ranges;
+
+	/** Start address of each range in @c ranges. */
+	addrxlat_addr_t *starts;
 };
 
 /** Clear a translation map.
@@ -237,6 +290,10 @@ map_clear(addrxlat_map_t *map)
 	map->n = 0;
 }
 
+INTERNAL_DECL(const addrxlat_range_t *, map_find,
+	      (const addrxlat_map_t *map, addrxlat_addr_t addr,
+	       addrxlat_addr_t *start));
+
 /** Translation system.
  */
 struct _addrxlat_sys {
@@ -248,6 +305,19 @@ struct _addrxlat_sys {
 
 	/** Address translation methods. */
 	addrxlat_meth_t meth[ADDRXLAT_SYS_METH_NUM];
+
+	/** Lookup tables owned by the translation system.
+	 * Lookup methods use a sorted private copy of the table,
+	 * so the caller's table is never modified.
+	 */
+	addrxlat_lookup_elem_t *lookup_tbl[ADDRXLAT_SYS_METH_NUM];
+
+	/** Generation number.
+	 * A new number is assigned whenever a map or method changes.
+	 * Numbers are unique among all translation systems, so they
+	 * identify both the system and its state in translation caches.
+	 */
+	unsigned long gen;
 };
 
 /* vtop */
@@ -508,12 +578,14 @@ DECLARE_ALIAS(map_new);
 DECLARE_ALIAS(map_incref);
 DECLARE_ALIAS(map_decref);
 DECLARE_ALIAS(map_set);
+DECLARE_ALIAS(map_set_bulk);
 DECLARE_ALIAS(map_search);
 DECLARE_ALIAS(map_copy);
 DECLARE_ALIAS(launch);
 DECLARE_ALIAS(step);
 DECLARE_ALIAS(walk);
 DECLARE_ALIAS(op);
+DECLARE_ALIAS(op_block);
 DECLARE_ALIAS(fulladdr_conv);
 
 /** Clear the error message.
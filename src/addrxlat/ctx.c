@@ -209,6 +209,7 @@ addrxlat_ctx_decref(addrxlat_ctx_t *ctx)
 	unsigned long refcnt = --ctx->refcnt;
 	if (!refcnt) {
 		cleanup_cache(&ctx->cache, &ctx->cb);
+		free(ctx->xlat.slot);
 		err_cleanup(&ctx->err);
 		free(ctx);
 	}
@@ -240,6 +241,7 @@ addrxlat_ctx_set_cb(addrxlat_ctx_t *ctx, const addrxlat_cb_t *cb)
 	ctx->cb = ctx->orig_cb = *cb;
 	if (hook)
 		hook(data, &ctx->cb);
+	addrxlat_ctx_flush_xlat_cache(ctx);
 }
 
 const addrxlat_cb_t *
@@ -254,6 +256,43 @@ addrxlat_ctx_get_ecb(addrxlat_ctx_t *ctx)
 	return &ctx->cb;
 }
 
+addrxlat_status
+addrxlat_ctx_set_xlat_cache(addrxlat_ctx_t *ctx, size_t size)
+{
+	struct xlat_cache_ent *slot;
+	size_t n;
+
+	clear_error(ctx);
+
+	if (size > SIZE_MAX / 2 / sizeof(*slot))
+		return set_error(ctx, ADDRXLAT_ERR_NOMEM,
+				 "Translation cache too big");
+
+	slot = NULL;
+	n = 1;
+	if (size) {
+		while (n < size)
+			n <<= 1;
+		slot = calloc(n, sizeof(*slot));
+		if (!slot)
+			return set_error(ctx, ADDRXLAT_ERR_NOMEM,
+					 "Cannot allocate translation cache");
+	}
+
+	free(ctx->xlat.slot);
+	ctx->xlat.slot = slot;
+	ctx->xlat.mask = n - 1;
+	return ADDRXLAT_OK;
+}
+
+void
+addrxlat_ctx_flush_xlat_cache(addrxlat_ctx_t *ctx)
+{
+	if (ctx->xlat.slot)
+		memset(ctx->xlat.slot, 0,
+		       (ctx->xlat.mask + 1) * sizeof(*ctx->xlat.slot));
+}
+
 /** Get the (string) name of an address space.
  * @param as  Address space.
  * @returns   The (human-readable) name of the address space.
@@ -64,6 +64,8 @@ addrxlat_map_decref(addrxlat_map_t *map)
 		map_clear(map);
 		if (map->ranges)
 			free(map->ranges);
+		if (map->starts)
+			free(map->starts);
 		free(map);
 	}
 	return refcnt;
@@ -81,6 +83,28 @@ addrxlat_map_ranges(const addrxlat_map_t *map)
 	return map->ranges;
 }
 
+/** Recompute range start addresses.
+ * @param map    Address translation map.
+ * @param first  Index of the first range which may have moved.
+ *
+ * The start addresses are kept in a separate array, so they can be
+ * searched without adding up range sizes.
+ */
+static void
+map_set_starts(addrxlat_map_t *map, size_t first)
+{
+	addrxlat_addr_t addr;
+	size_t i;
+
+	addr = first
+		? map->starts[first - 1] + map->ranges[first - 1].endoff + 1
+		: 0;
+	for (i = first; i < map->n; ++i) {
+		map->starts[i] = addr;
+		addr += map->ranges[i].endoff + 1;
+	}
+}
+
 DEFINE_ALIAS(map_set);
 
 addrxlat_status
@@ -163,10 +187,23 @@ addrxlat_map_set(addrxlat_map_t *map, addrxlat_addr_t addr,
 	/* (re-)allocate if growing */
 	if (delta > 0) {
 		size_t newn = delta + (map ? map->n : 0);
-		addrxlat_range_t *newranges =
-			realloc(map->ranges, newn * sizeof(newranges[0]));
+		addrxlat_range_t *newranges;
+		addrxlat_addr_t *newstarts;
+
+		newranges = realloc(map->ranges, newn * sizeof(newranges[0]));
 		if (!newranges)
 			return ADDRXLAT_ERR_NOMEM;
+		if (first) {
+			first = &newranges[first - map->ranges];
+			last = &newranges[last - map->ranges];
+		}
+		map->ranges = newranges;
+
+		/* On failure, the map is unchanged; only ranges is larger. */
+		newstarts = realloc(map->starts, newn * sizeof(newstarts[0]));
+		if (!newstarts)
+			return ADDRXLAT_ERR_NOMEM;
+		map->starts = newstarts;
 
 		if (!first) {
 			map->n = 1;
@@ -175,11 +212,7 @@ addrxlat_map_set(addrxlat_map_t *map, addrxlat_addr_t addr,
 			first->meth = ADDRXLAT_SYS_METH_NONE;
 			++left;
 			--delta;
-		} else {
-			first = &newranges[first - map->ranges];
-			last = &newranges[last - map->ranges];
 		}
-		map->ranges = newranges;
 	}
 
 	if (delta) {
@@ -200,7 +233,195 @@ addrxlat_map_set(addrxlat_map_t *map, addrxlat_addr_t addr,
 
 	first->endoff = range->endoff + extend;
 	first->meth = range->meth;
+	map_set_starts(map, first > map->ranges ? first - map->ranges - 1 : 0);
+	return ADDRXLAT_OK;
+}
+
+/** Range used by @ref addrxlat_map_set_bulk. */
+struct bulk_ent {
+	addrxlat_addr_t addr;	 /**< First address. */
+	addrxlat_addr_t end;	 /**< Last address. */
+	addrxlat_sys_meth_t meth; /**< Translation method index. */
+	size_t prio;		 /**< Priority (higher wins). */
+};
+
+static int
+bulk_ent_cmp(const void *a, const void *b)
+{
+	const struct bulk_ent *ea = a, *eb = b;
+	return ea->addr != eb->addr ? (ea->addr < eb->addr ? -1 : 1) : 0;
+}
+
+/** Add a range to a max-heap ordered by priority.
+ * @param heap  Heap array.
+ * @param n     Number of elements in @p heap (before adding).
+ * @param ent   Range to be added.
+ */
+static void
+bulk_heap_push(const struct bulk_ent **heap, size_t n,
+	       const struct bulk_ent *ent)
+{
+	size_t parent;
+
+	while (n > 0) {
+		parent = (n - 1) / 2;
+		if (heap[parent]->prio >= ent->prio)
+			break;
+		heap[n] = heap[parent];
+		n = parent;
+	}
+	heap[n] = ent;
+}
+
+/** Remove the top element from a max-heap ordered by priority.
+ * @param heap  Heap array.
+ * @param n     Number of elements in @p heap (after removal).
+ */
+static void
+bulk_heap_pop(const struct bulk_ent **heap, size_t n)
+{
+	const struct bulk_ent *last = heap[n];
+	size_t i = 0, child;
+
+	while ((child = 2 * i + 1) < n) {
+		if (child + 1 < n && heap[child + 1]->prio > heap[child]->prio)
+			++child;
+		if (last->prio >= heap[child]->prio)
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = last;
+}
+
+DEFINE_ALIAS(map_set_bulk);
+
+addrxlat_status
+addrxlat_map_set_bulk(addrxlat_map_t *map, const addrxlat_map_ent_t *ents,
+		      size_t n)
+{
+	struct bulk_ent *sorted;
+	const struct bulk_ent **heap;
+	addrxlat_range_t *ranges, *r;
+	addrxlat_addr_t *starts;
+	addrxlat_addr_t cur, end;
+	size_t total, i, next, nheap;
+
+	if (!n)
+		return ADDRXLAT_OK;
+
+	/* Existing ranges have the lowest priority. An empty map is
+	 * treated as a single range without a method. */
+	total = (map->n ? map->n : 1) + n;
+	sorted = malloc(total * sizeof(*sorted));
+	heap = malloc(total * sizeof(*heap));
+	ranges = malloc((2 * total + 1) * sizeof(*ranges));
+	if (!sorted || !heap || !ranges)
+		goto err_nomem;
+
+	cur = 0;
+	for (i = 0; i < map->n; ++i) {
+		sorted[i].addr = cur;
+		sorted[i].end = cur + map->ranges[i].endoff;
+		sorted[i].meth = map->ranges[i].meth;
+		sorted[i].prio = i;
+		cur = sorted[i].end + 1;
+	}
+	if (!map->n) {
+		sorted[0].addr = 0;
+		sorted[0].end = ADDRXLAT_ADDR_MAX;
+		sorted[0].meth = ADDRXLAT_SYS_METH_NONE;
+		sorted[0].prio = 0;
+		i = 1;
+	}
+	for (next = 0; next < n; ++next, ++i) {
+		sorted[i].addr = ents[next].addr;
+		sorted[i].end = ents[next].addr + ents[next].range.endoff;
+		if (sorted[i].end < sorted[i].addr)
+			sorted[i].end = ADDRXLAT_ADDR_MAX;
+		sorted[i].meth = ents[next].range.meth;
+		sorted[i].prio = i;
+	}
+	qsort(sorted, total, sizeof(*sorted), bulk_ent_cmp);
+
+	/* Sweep the address space. The range with the highest priority
+	 * among those which contain the current address wins. */
+	r = NULL;
+	cur = 0;
+	next = 0;
+	nheap = 0;
+	for (;;) {
+		while (next < total && sorted[next].addr <= cur)
+			bulk_heap_push(heap, nheap++, &sorted[next++]);
+		while (heap[0]->end < cur)
+			bulk_heap_pop(heap, --nheap);
+
+		end = heap[0]->end;
+		if (next < total && sorted[next].addr - 1 < end)
+			end = sorted[next].addr - 1;
+
+		if (r && r->meth == heap[0]->meth)
+			r->endoff += end - cur + 1;
+		else {
+			r = r ? r + 1 : ranges;
+			r->endoff = end - cur;
+			r->meth = heap[0]->meth;
+		}
+
+		if (end == ADDRXLAT_ADDR_MAX)
+			break;
+		cur = end + 1;
+	}
+
+	starts = malloc((r - ranges + 1) * sizeof(*starts));
+	if (!starts)
+		goto err_nomem;
+	free(map->starts);
+	map->starts = starts;
+	free(map->ranges);
+	map->ranges = ranges;
+	map->n = r - ranges + 1;
+	map_set_starts(map, 0);
+
+	free(heap);
+	free(sorted);
 	return ADDRXLAT_OK;
+
+ err_nomem:
+	free(ranges);
+	free(heap);
+	free(sorted);
+	return ADDRXLAT_ERR_NOMEM;
+}
+
+/** Find the range which contains an address.
+ * @param map    Address translation map.
+ * @param addr   Address to be found.
+ * @param start  Set to the first address of the range on success.
+ * @returns      The range containing @p addr, or @c NULL if @p map
+ *               is empty.
+ */
+const addrxlat_range_t *
+map_find(const addrxlat_map_t *map, addrxlat_addr_t addr,
+	 addrxlat_addr_t *start)
+{
+	const addrxlat_addr_t *base = map->starts;
+	size_t n = map->n;
+	size_t half;
+
+	if (!n)
+		return NULL;
+
+	/* Find the last range which starts at or below addr. The first
+	 * range always starts at zero. The loop body compiles to a
+	 * conditional move, so it does not mispredict. */
+	while (n > 1) {
+		half = n / 2;
+		base = (base[half] <= addr) ? base + half : base;
+		n -= half;
+	}
+	*start = *base;
+	return &map->ranges[base - map->starts];
 }
 
 DEFINE_ALIAS(map_search);
@@ -208,17 +429,11 @@ DEFINE_ALIAS(map_search);
 addrxlat_sys_meth_t
 addrxlat_map_search(const addrxlat_map_t *map, addrxlat_addr_t addr)
 {
-	const addrxlat_range_t *r = map->ranges;
-	addrxlat_addr_t raddr = 0;
-	size_t left = map->n;
-
-	while (left-- > 0) {
-		if (addr <= raddr + r->endoff)
-			return r->meth;
-		raddr += r->endoff + 1;
-		++r;
-	}
-	return ADDRXLAT_SYS_METH_NONE;
+	const addrxlat_range_t *range;
+	addrxlat_addr_t start;
+
+	range = map_find(map, addr, &start);
+	return range ? range->meth : ADDRXLAT_SYS_METH_NONE;
 }
 
 DEFINE_ALIAS(map_copy);
@@ -236,7 +451,8 @@ addrxlat_map_copy(const addrxlat_map_t *map)
 		return ret;
 
 	ret->ranges = malloc(map->n * sizeof(ret->ranges[0]));
-	if (!ret->ranges) {
+	ret->starts = malloc(map->n * sizeof(ret->starts[0]));
+	if (!ret->ranges || !ret->starts) {
 		internal_map_decref(ret);
 		return NULL;
 	}
@@ -246,6 +462,7 @@ addrxlat_map_copy(const addrxlat_map_t *map)
 	todo = ret->n = map->n;
 	while (todo--)
 		*r++ = *q++;
+	memcpy(ret->starts, map->starts, map->n * sizeof(ret->starts[0]));
 
 	return ret;
 }
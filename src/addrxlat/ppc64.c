@@ -337,6 +337,7 @@ get_vmemmap_param(struct os_init_data *ctl, addrxlat_param_lookup_t *param)
 		elem = data;
 	}
 
+	lookup_sort(param);
 	return ADDRXLAT_OK;
 
  err_free:
@@ -399,6 +400,10 @@ map_linux_ppc64(struct os_init_data *ctl)
 	}
 	if (status != ADDRXLAT_OK)
 		return status;
+	if (ctl->sys->lookup_tbl[ADDRXLAT_SYS_METH_VMEMMAP])
+		free(ctl->sys->lookup_tbl[ADDRXLAT_SYS_METH_VMEMMAP]);
+	ctl->sys->lookup_tbl[ADDRXLAT_SYS_METH_VMEMMAP] =
+		meth->param.lookup.tbl;
 	meth->kind = ADDRXLAT_LOOKUP;
 	meth->target_as = ADDRXLAT_KPHYSADDR;
 	meth->param.lookup.endoff = pagesize - 1;
@@ -28,6 +28,7 @@
    not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "addrxlat-priv.h"
@@ -338,31 +339,123 @@ next_step_pgt(addrxlat_step_t *step)
 	};
 }
 
+static int
+lookup_elem_cmp(const void *a, const void *b)
+{
+	const addrxlat_lookup_elem_t *ea = a, *eb = b;
+	return ea->orig != eb->orig ? (ea->orig < eb->orig ? -1 : 1) : 0;
+}
+
+/** Check whether a lookup table is sorted by original address.
+ * @param lookup  Lookup method parameters.
+ * @returns       Non-zero if the table is sorted.
+ */
+static int
+lookup_is_sorted(const addrxlat_param_lookup_t *lookup)
+{
+	size_t i;
+
+	for (i = 1; i < lookup->nelem; ++i)
+		if (lookup->tbl[i].orig < lookup->tbl[i - 1].orig)
+			return 0;
+	return 1;
+}
+
+/** Sort a lookup table by original address.
+ * @param lookup  Lookup method parameters.
+ *
+ * Lookup tables are searched with binary search, so they must be sorted.
+ * The table is sorted in place, so it must be owned by the library.
+ * An already sorted table is not modified.
+ */
+void
+lookup_sort(addrxlat_param_lookup_t *lookup)
+{
+	if (!lookup_is_sorted(lookup))
+		qsort(lookup->tbl, lookup->nelem, sizeof(*lookup->tbl),
+		      lookup_elem_cmp);
+}
+
+/** Check whether a lookup table element contains an address.
+ * @param lookup  Lookup method parameters.
+ * @param idx     Index of the element in the table.
+ * @param addr    Address to be translated.
+ * @returns       Non-zero if the element contains @p addr.
+ */
+static inline int
+lookup_elem_match(const addrxlat_param_lookup_t *lookup, size_t idx,
+		  addrxlat_addr_t addr)
+{
+	const addrxlat_lookup_elem_t *elem;
+
+	if (idx >= lookup->nelem)
+		return 0;
+	elem = &lookup->tbl[idx];
+	return elem->orig <= addr && addr - elem->orig <= lookup->endoff;
+}
+
 /** Initialize step state for table lookup.
  * @param step  Step state.
  * @param addr  Address to be translated.
  * @returns     Error status.
+ *
+ * The lookup table must be sorted by original address. Since all
+ * objects have the same size, if any element contains @p addr, then
+ * so does the last element which starts at or below @p addr. If
+ * objects overlap, the lowest matching element is used. Sequential
+ * translations usually hit the same element as last time in this
+ * context, or the next one.
+ *
+ * The table is not checked on success, because any element which
+ * contains @p addr is a valid result. If the address is not found,
+ * an unsorted table is reported as an error, so a search miss is
+ * never confused with an unmapped address.
  */
 static addrxlat_status
 first_step_lookup(addrxlat_step_t *step, addrxlat_addr_t addr)
 {
 	const addrxlat_param_lookup_t *lookup = &step->meth->param.lookup;
-	size_t i;
+	addrxlat_ctx_t *ctx = step->ctx;
+	const addrxlat_lookup_elem_t *base;
+	size_t i, n, half;
+
+	if (ctx->lookup_tbl == lookup->tbl) {
+		i = ctx->lookup_hint;
+		if (lookup_elem_match(lookup, i, addr) ||
+		    lookup_elem_match(lookup, ++i, addr))
+			goto found;
+	}
 
-	for (i = 0; i < lookup->nelem; ++i) {
-		const addrxlat_lookup_elem_t *elem = &lookup->tbl[i];
-		if (elem->orig <= addr &&
-		    addr <= elem->orig + lookup->endoff) {
-			step->base.as = step->meth->target_as;
-			step->base.addr = elem->dest;
-			step->remain = 1;
-			step->elemsz = 1;
-			step->idx[0] = addr - elem->orig;
-			return ADDRXLAT_OK;
-		}
+	n = lookup->nelem;
+	if (!n || lookup->tbl[0].orig > addr)
+		goto notfound;
+	base = lookup->tbl;
+	while (n > 1) {
+		half = n / 2;
+		base = (base[half].orig <= addr) ? base + half : base;
+		n -= half;
 	}
+	i = base - lookup->tbl;
+	if (addr - base->orig > lookup->endoff)
+		goto notfound;
+
+ found:
+	while (i && lookup_elem_match(lookup, i - 1, addr))
+		--i;
+	ctx->lookup_tbl = lookup->tbl;
+	ctx->lookup_hint = i;
+	step->base.as = step->meth->target_as;
+	step->base.addr = lookup->tbl[i].dest;
+	step->remain = 1;
+	step->elemsz = 1;
+	step->idx[0] = addr - lookup->tbl[i].orig;
+	return ADDRXLAT_OK;
 
-	return set_error(step->ctx, ADDRXLAT_ERR_NOTPRESENT, "Not mapped");
+ notfound:
+	if (!lookup_is_sorted(lookup))
+		return set_error(ctx, ADDRXLAT_ERR_INVALID,
+				 "Lookup table is not sorted");
+	return set_error(ctx, ADDRXLAT_ERR_NOTPRESENT, "Not mapped");
 }
 
 /** Initialize step state for memory array lookup.
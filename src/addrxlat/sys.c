@@ -33,6 +33,20 @@
 
 #include "addrxlat-priv.h"
 
+/**  Assign a new generation number to a translation system.
+ * @param sys  Translation system.
+ *
+ * This must be called whenever a map or method of the system changes,
+ * so that cached translations are no longer used.
+ */
+static void
+sys_changed(addrxlat_sys_t *sys)
+{
+	static unsigned long last_gen;
+
+	sys->gen = __atomic_add_fetch(&last_gen, 1, __ATOMIC_RELAXED);
+}
+
 addrxlat_sys_t *
 addrxlat_sys_new(void)
 {
@@ -41,6 +55,7 @@ addrxlat_sys_new(void)
 	ret = calloc(1, sizeof(addrxlat_sys_t));
 	if (ret) {
 		ret->refcnt = 1;
+		sys_changed(ret);
 	}
 	return ret;
 }
@@ -71,7 +86,12 @@ addrxlat_sys_decref(addrxlat_sys_t *sys)
 {
 	unsigned long refcnt = --sys->refcnt;
 	if (!refcnt) {
+		unsigned i;
+
 		sys_cleanup(sys);
+		for (i = 0; i < ADDRXLAT_SYS_METH_NUM; ++i)
+			if (sys->lookup_tbl[i])
+				free(sys->lookup_tbl[i]);
 		free(sys);
 	}
 	return refcnt;
@@ -105,6 +125,7 @@ addrxlat_sys_os_init(addrxlat_sys_t *sys, addrxlat_ctx_t *ctx,
 				"Unsupported architecture");
 
 	sys_cleanup(sys);
+	sys_changed(sys);
 
 	ctl.sys = sys;
 	ctl.ctx = ctx;
@@ -114,7 +135,11 @@ addrxlat_sys_os_init(addrxlat_sys_t *sys, addrxlat_ctx_t *ctx,
 	if (status != ADDRXLAT_OK)
 		return status;
 
-	return arch_fn(&ctl);
+	/* Translations made during initialization may have been cached
+	 * with an incomplete system. */
+	status = arch_fn(&ctl);
+	sys_changed(sys);
+	return status;
 }
 
 void
@@ -126,6 +151,7 @@ addrxlat_sys_set_map(addrxlat_sys_t *sys, addrxlat_sys_map_t idx,
 	if (sys->map[idx])
 		internal_map_decref(sys->map[idx]);
 	sys->map[idx] = map;
+	sys_changed(sys);
 }
 
 addrxlat_map_t *
@@ -138,7 +164,29 @@ void
 addrxlat_sys_set_meth(addrxlat_sys_t *sys,
 		      addrxlat_sys_meth_t idx, const addrxlat_meth_t *meth)
 {
+	addrxlat_param_lookup_t *lookup = &sys->meth[idx].param.lookup;
+	addrxlat_lookup_elem_t *tbl = NULL;
+
 	sys->meth[idx] = *meth;
+	if (sys->meth[idx].kind == ADDRXLAT_LOOKUP) {
+		/* Keep the table if @p meth is the current method. */
+		if (lookup->tbl == sys->lookup_tbl[idx])
+			tbl = lookup->tbl;
+		else if (!lookup->nelem)
+			lookup->tbl = NULL;
+		else if (!(tbl = malloc(lookup->nelem * sizeof(*tbl))))
+			sys->meth[idx].kind = ADDRXLAT_NOMETH;
+		else {
+			memcpy(tbl, lookup->tbl,
+			       lookup->nelem * sizeof(*tbl));
+			lookup->tbl = tbl;
+			lookup_sort(lookup);
+		}
+	}
+	if (sys->lookup_tbl[idx] && sys->lookup_tbl[idx] != tbl)
+		free(sys->lookup_tbl[idx]);
+	sys->lookup_tbl[idx] = tbl;
+	sys_changed(sys);
 }
 
 const addrxlat_meth_t *
@@ -147,6 +195,12 @@ addrxlat_sys_get_meth(const addrxlat_sys_t *sys, addrxlat_sys_meth_t idx)
 	return &sys->meth[idx];
 }
 
+unsigned long
+addrxlat_sys_get_gen(const addrxlat_sys_t *sys)
+{
+	return sys->gen;
+}
+
 /** Action function for @ref SYS_ACT_DIRECT.
  * @param ctl     Initialization data.
  * @param region  Directmap region definition.
@@ -237,6 +291,8 @@ sys_set_layout(struct os_init_data *ctl, addrxlat_sys_map_t idx,
 {
 	const struct sys_region *region;
 	addrxlat_map_t *map = ctl->sys->map[idx];
+	addrxlat_map_ent_t *ents, *ent;
+	addrxlat_status status;
 
 	if (!map) {
 		map = internal_map_new();
@@ -247,18 +303,26 @@ sys_set_layout(struct os_init_data *ctl, addrxlat_sys_map_t idx,
 	}
 
 	for (region = layout; region->meth != ADDRXLAT_SYS_METH_NUM;
-	     ++region) {
-		addrxlat_range_t range;
-		addrxlat_status status;
-
-		range.endoff = region->last - region->first;
-		range.meth = region->meth;
+	     ++region);
+	ents = malloc((region - layout) * sizeof(*ents));
+	if (!ents && region != layout)
+		return set_error(ctl->ctx, ADDRXLAT_ERR_NOMEM,
+				 "Cannot allocate layout ranges");
+
+	for (region = layout, ent = ents;
+	     region->meth != ADDRXLAT_SYS_METH_NUM;
+	     ++region, ++ent) {
+		ent->addr = region->first;
+		ent->range.endoff = region->last - region->first;
+		ent->range.meth = region->meth;
 
 		switch (region->act) {
 		case SYS_ACT_DIRECT:
 			status = act_direct(ctl, region);
-			if (status != ADDRXLAT_OK)
+			if (status != ADDRXLAT_OK) {
+				free(ents);
 				return status;
+			}
 			break;
 
 		case SYS_ACT_RDIRECT:
@@ -276,17 +340,14 @@ sys_set_layout(struct os_init_data *ctl, addrxlat_sys_map_t idx,
 		default:
 			break;
 		}
-
-		status = internal_map_set(map, region->first, &range);
-		if (status != ADDRXLAT_OK)
-			return set_error(ctl->ctx, status,
-					 "Cannot set up mapping for"
-					 " 0x%"ADDRXLAT_PRIxADDR
-					 "-0x%"ADDRXLAT_PRIxADDR,
-					 region->first,
-					 region->last);
 	}
 
+	status = internal_map_set_bulk(map, ents, ent - ents);
+	free(ents);
+	if (status != ADDRXLAT_OK)
+		return set_error(ctl->ctx, status,
+				 "Cannot set up memory layout");
+
 	return ADDRXLAT_OK;
 }
 
@@ -404,10 +465,111 @@ struct inflight {
 	struct inflight *next;
 };
 
+/** Narrow down a block of addresses with the same translation offset.
+ * @param below  Distance from the first address of the block (updated).
+ * @param above  Distance to the last address of the block (updated).
+ * @param first  Distance from the first address of another block.
+ * @param last   Distance to the last address of another block.
+ *
+ * The resulting block is the intersection of both blocks. All distances
+ * are measured from the address being translated.
+ */
+static inline void
+clip_block(addrxlat_addr_t *below, addrxlat_addr_t *above,
+	   addrxlat_addr_t first, addrxlat_addr_t last)
+{
+	if (first < *below)
+		*below = first;
+	if (last < *above)
+		*above = last;
+}
+
+/** Clip a block of addresses to the final step of a translation.
+ * @param step   Step state after a successful walk.
+ * @param level  Page table level of the leaf entry.
+ * @param below  Distance from the first address of the block (updated).
+ * @param above  Distance to the last address of the block (updated).
+ * @returns      Non-zero on success, zero if the final step is unknown.
+ *
+ * The @p level is used only for page tables. It is greater than one
+ * if the walk ended early on a huge page.
+ */
+static int
+clip_step_block(const addrxlat_step_t *step, unsigned short level,
+		addrxlat_addr_t *below, addrxlat_addr_t *above)
+{
+	const addrxlat_meth_t *meth = step->meth;
+	addrxlat_addr_t mask, off;
+
+	switch (meth->kind) {
+	case ADDRXLAT_PGT:
+		if (!meth->param.pgt.pf.nfields)
+			return 0;
+		mask = pf_table_span(&meth->param.pgt.pf, level) - 1;
+		break;
+
+	case ADDRXLAT_LOOKUP:
+		clip_block(below, above, step->idx[0],
+			   meth->param.lookup.endoff - step->idx[0]);
+		return 1;
+
+	case ADDRXLAT_MEMARR:
+		mask = ADDR_MASK(meth->param.memarr.shift);
+		break;
+
+	default:
+		return 0;
+	}
+
+	off = step->idx[0] & mask;
+	clip_block(below, above, off, mask - off);
+	return 1;
+}
+
+/** Get the translation cache slot for an address.
+ * @param cache  Translation cache.
+ * @param addr   Source address.
+ * @returns      Cache slot.
+ */
+static inline struct xlat_cache_ent *
+xlat_cache_slot(const struct xlat_cache *cache, addrxlat_addr_t addr)
+{
+	return &cache->slot[(addr >> XLAT_CACHE_SHIFT) & cache->mask];
+}
+
+/** Walk a translation method and find the page table level of the leaf.
+ * @param step   Step state, initialized as for @ref addrxlat_walk.
+ * @param level  Set to the page table level of the leaf entry.
+ * @returns      Error status.
+ *
+ * This is like @ref addrxlat_walk, but the translation is done step by
+ * step to find out if the walk ended early on a huge page.
+ */
+static addrxlat_status
+walk_leaf(addrxlat_step_t *step, unsigned short *level)
+{
+	addrxlat_status status;
+
+	status = internal_launch(step, step->base.addr);
+	*level = 1;
+	while (status == ADDRXLAT_OK && step->remain) {
+		unsigned short remain = step->remain;
+		status = internal_step(step);
+		if (step->remain == 1 && remain > 1)
+			*level = remain - 1;
+	}
+	return status;
+}
+
 static addrxlat_status
 do_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr,
-      const struct xlat_chain *chain)
+      const struct xlat_chain *chain,
+      addrxlat_addr_t *pbelow, addrxlat_addr_t *pabove)
 {
+	const addrxlat_fulladdr_t *src = paddr;
+	addrxlat_addr_t below, above;
+	unsigned short level;
+	int cacheable;
 	unsigned i, j;
 	addrxlat_fulladdr_t lastbase;
 	addrxlat_step_t step;
@@ -416,13 +578,20 @@ do_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr,
 	step.ctx = ctl->ctx;
 	step.sys = ctl->sys;
 
+	/* Track the block of source addresses around paddr which are
+	 * translated by the same offset. */
+	below = paddr->addr;
+	above = ADDRXLAT_ADDR_MAX - paddr->addr;
+	cacheable = 1;
+
 	for (i = 0; i < chain->len; ++i) {
 		const struct xlat_alt *alt = &chain->alt[i];
 
 		for (j = 0; j < alt->num; ++j) {
 			addrxlat_sys_map_t mapidx = alt->map[j];
+			const addrxlat_range_t *range;
+			addrxlat_addr_t start, off;
 			addrxlat_map_t *map;
-			addrxlat_sys_meth_t methidx;
 			addrxlat_meth_t *meth;
 
 			if (paddr->as != map_expect_as[mapidx])
@@ -433,43 +602,75 @@ do_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr,
 				continue;
 
 			clear_error(ctl->ctx);
-			methidx = internal_map_search(map, paddr->addr);
-			if (methidx == ADDRXLAT_SYS_METH_NONE)
+			range = map_find(map, paddr->addr, &start);
+			if (!range)
+				continue;
+			off = paddr->addr - start;
+			clip_block(&below, &above, off, range->endoff - off);
+			if (range->meth == ADDRXLAT_SYS_METH_NONE)
 				continue;
 
-			meth = &ctl->sys->meth[methidx];
+			meth = &ctl->sys->meth[range->meth];
 			if (meth->kind == ADDRXLAT_LINEAR) {
 				lastbase.as = meth->target_as;
 				lastbase.addr =
 					paddr->addr + meth->param.linear.off;
 				if (ctl->caps & ADDRXLAT_CAPS(lastbase.as))
-					return ctl->op(ctl->data, &lastbase);
+					goto found;
 				paddr = &lastbase;
 				break;
 			}
 
 			step.meth = meth;
 			step.base.addr = paddr->addr;
-			status = internal_walk(&step);
+			status = walk_leaf(&step, &level);
 			if (status == ADDRXLAT_OK) {
-				if (ctl->caps & ADDRXLAT_CAPS(step.base.as))
-					return ctl->op(ctl->data, &step.base);
+				if (!clip_step_block(&step, level,
+						     &below, &above))
+					cacheable = 0;
 				lastbase = step.base;
+				if (ctl->caps & ADDRXLAT_CAPS(lastbase.as))
+					goto found;
 				paddr = &lastbase;
 				break;
 			} else if (status != ADDRXLAT_ERR_NOMETH &&
 				   status != ADDRXLAT_ERR_NODATA)
 				return status;
+
+			/* Another address in the block may be translated
+			 * by this method. */
+			cacheable = 0;
 		}
 	}
 
 	return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH, "No way to translate");
+
+ found:
+	if (!cacheable) {
+		below = 0;
+		above = 0;
+	} else if (ctl->ctx->xlat.slot) {
+		struct xlat_cache_ent *ent =
+			xlat_cache_slot(&ctl->ctx->xlat, src->addr);
+		ent->gen = ctl->sys->gen;
+		ent->caps = ctl->caps;
+		ent->as = src->as;
+		ent->addr = src->addr - below;
+		ent->endoff = below + above;
+		ent->target.as = lastbase.as;
+		ent->target.addr = lastbase.addr - below;
+	}
+	*pbelow = below;
+	*pabove = above;
+	return ctl->op(ctl->data, &lastbase);
 }
 
-DEFINE_ALIAS(op);
+DEFINE_ALIAS(op_block);
 
 addrxlat_status
-addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
+addrxlat_op_block(const addrxlat_op_ctl_t *ctl,
+		  const addrxlat_fulladdr_t *paddr,
+		  addrxlat_addr_t *below, addrxlat_addr_t *above)
 {
 	struct inflight inflight, *pif;
 	const struct xlat_chain *chain;
@@ -477,8 +678,11 @@ addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
 
 	clear_error(ctl->ctx);
 
-	if (ctl->caps & ADDRXLAT_CAPS(paddr->as))
+	if (ctl->caps & ADDRXLAT_CAPS(paddr->as)) {
+		*below = paddr->addr;
+		*above = ADDRXLAT_ADDR_MAX - paddr->addr;
 		return ctl->op(ctl->data, paddr);
+	}
 
 	/* Check that some translation is possible. */
 	if ((ctl->caps & (ADDRXLAT_CAPS(ADDRXLAT_KVADDR) |
@@ -491,6 +695,22 @@ addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
 		return set_error(ctl->ctx, ADDRXLAT_ERR_NOMETH,
 				 "No translation system");
 
+	if (ctl->ctx->xlat.slot) {
+		const struct xlat_cache_ent *ent =
+			xlat_cache_slot(&ctl->ctx->xlat, paddr->addr);
+		if (ent->gen == ctl->sys->gen &&
+		    ent->caps == ctl->caps &&
+		    ent->as == paddr->as &&
+		    paddr->addr - ent->addr <= ent->endoff) {
+			addrxlat_fulladdr_t faddr;
+			*below = paddr->addr - ent->addr;
+			*above = ent->endoff - *below;
+			faddr.as = ent->target.as;
+			faddr.addr = ent->target.addr + *below;
+			return ctl->op(ctl->data, &faddr);
+		}
+	}
+
 	switch (paddr->as) {
 	case ADDRXLAT_KVADDR:
 		chain = &kv2phys;
@@ -524,12 +744,21 @@ addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
 	inflight.next = ctl->ctx->inflight;
 	ctl->ctx->inflight = &inflight;
 
-	status = do_op(ctl, paddr, chain);
+	status = do_op(ctl, paddr, chain, below, above);
 
 	ctl->ctx->inflight = inflight.next;
 	return status;
 }
 
+DEFINE_ALIAS(op);
+
+addrxlat_status
+addrxlat_op(const addrxlat_op_ctl_t *ctl, const addrxlat_fulladdr_t *paddr)
+{
+	addrxlat_addr_t below, above;
+	return internal_op_block(ctl, paddr, &below, &above);
+}
+
 static addrxlat_status
 storeaddr(void *data, const addrxlat_fulladdr_t *paddr)
 {
@@ -33,6 +33,7 @@
 #include "kdumpfile-priv.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 
 /**  Simple cache.
@@ -70,8 +71,46 @@
  * between ghost probed and ghost precious lists. This part of the cache
  * is usually empty; it's used only after a flush or when an entry is
  * discarded.
+ *
+ * Cached (probed and precious) entries are also linked into a hash index,
+ * which allows to look up an entry without holding the cache mutex.
+ * Such lock-free lookups are protected by a sequence count, which is
+ * incremented before and after any change that may evict an entry.
+ * A lock-free hit does not move the entry in the list. Instead, it only
+ * marks the entry as referenced, and the entry is moved next time the
+ * cache is accessed with the mutex held.
+ *
+ * If all entries are in use, the behaviour depends on the cache full
+ * policy. The lookup may fail, wait until an entry is released, or
+ * return an elastic entry, which is allocated separately and freed
+ * when its last reference is dropped.
+ *
+ * A cache may also be split into shards to reduce lock contention.
+ * The top-level object of a sharded cache holds no entries of its own;
+ * every key is mapped to one of the shards by a hash function, and each
+ * shard is a complete cache with its own lock. Statistics counters are
+ * shared by all shards and stored in the top-level object.
  */
 struct cache {
+	mutex_t mutex;		 /**< Guard accesses to cache metadata. */
+
+	struct cache *top;	 /**< Top-level cache (holds statistics) */
+	unsigned nshards;	 /**< Number of shards (zero if not sharded) */
+	struct cache **shards;	 /**< Shards of a sharded cache */
+
+	unsigned seq;		 /**< Sequence count for lock-free lookups */
+	unsigned char hits_pending; /**< Non-zero if there are referenced
+				  *   entries which have not been moved yet */
+	unsigned hbits;		 /**< Number of bits in hash index */
+	unsigned hmul;		 /**< Hash multiplier (number of shards) */
+	unsigned *hash;		 /**< Heads of hash chains */
+
+	/** Policy if all entries are in use. */
+	kdump_cache_full_policy_t full_policy;
+	cond_t released;	 /**< Signalled when an entry is released */
+	unsigned nwaiters;	 /**< Number of threads waiting for
+				  *   @ref released */
+
 	unsigned split;		 /**< Split point between probed and precious
 				  *   entries (index of MRU probed entry) */
 	unsigned nprec;		 /**< Number of cached precious entries */
@@ -114,6 +153,113 @@ struct cache_search {
 	unsigned nuprobe;	/**< Number of unused probed entries. */
 };
 
+/**  Increment a cache statistics counter.
+ * @param counter  Counter in the top-level cache object.
+ *
+ * Shards of a sharded cache are protected by different locks, but they
+ * share the statistics counters, so the counters must be updated
+ * atomically.
+ */
+static inline void
+count_event(kdump_attr_value_t *counter)
+{
+	__atomic_fetch_add(&counter->number, 1, __ATOMIC_RELAXED);
+}
+
+/** Hash chain terminator. */
+#define NO_ENTRY	(~0U)
+
+/**  Hash a cache key.
+ * @param key  Cache entry key.
+ * @returns    32-bit hash value.
+ */
+static inline uint_fast64_t
+key_hash(cache_key_t key)
+{
+	return fold_hash(key, 32);
+}
+
+/**  Get the cache shard for a given key.
+ * @param cache  Cache object.
+ * @param key    Cache entry key.
+ * @returns      Shard which holds entries for @p key, or @p cache
+ *               itself if it is not sharded.
+ */
+static inline struct cache *
+key_shard(struct cache *cache, cache_key_t key)
+{
+	if (cache->nshards)
+		cache = cache->shards[(key_hash(key) * cache->nshards) >> 32];
+	return cache;
+}
+
+/**  Get the hash chain index for a given key.
+ * @param cache  Cache object.
+ * @param key    Cache entry key.
+ * @returns      Index into the hash chain table.
+ *
+ * The shard is selected by the integer part of the scaled hash value,
+ * so use the fractional part here; otherwise, all keys in a shard would
+ * share the same high bits.
+ */
+static inline unsigned
+hash_index(struct cache *cache, cache_key_t key)
+{
+	uint_fast64_t hash = (key_hash(key) * cache->hmul) & 0xffffffff;
+	return hash >> (32 - cache->hbits);
+}
+
+/**  Add a cached entry to the hash index.
+ * @param cache  Cache object (locked).
+ * @param entry  Cache entry.
+ * @param idx    Index of @p entry.
+ */
+static void
+hash_entry(struct cache *cache, struct cache_entry *entry, unsigned idx)
+{
+	unsigned *head = &cache->hash[hash_index(cache, entry->key)];
+	entry->hnext = *head;
+	__atomic_store_n(head, idx, __ATOMIC_RELEASE);
+}
+
+/**  Remove a cached entry from the hash index.
+ * @param cache  Cache object (locked).
+ * @param entry  Cache entry.
+ */
+static void
+unhash_entry(struct cache *cache, struct cache_entry *entry)
+{
+	unsigned idx = entry - cache->ce;
+	unsigned *pnext = &cache->hash[hash_index(cache, entry->key)];
+	while (*pnext != idx)
+		pnext = &cache->ce[*pnext].hnext;
+	__atomic_store_n(pnext, entry->hnext, __ATOMIC_RELAXED);
+}
+
+/**  Start a change which may evict cached entries.
+ * @param cache  Cache object (locked).
+ *
+ * The full barrier orders the sequence count update before any
+ * subsequent loads of entry reference counts. A concurrent lock-free
+ * lookup either sees the new sequence count, or its reference to
+ * the entry is seen by this thread.
+ */
+static inline void
+write_seqbegin(struct cache *cache)
+{
+	__atomic_store_n(&cache->seq, cache->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/**  Finish a change which may evict cached entries.
+ * @param cache  Cache object (locked).
+ */
+static inline void
+write_seqend(struct cache *cache)
+{
+	__atomic_store_n(&cache->seq, cache->seq + 1, __ATOMIC_RELEASE);
+}
+
 /**  Add an entry to the list after a given point.
  * @param cache   Cache object.
  * @param entry   Cache entry to be added.
@@ -217,8 +363,6 @@ reuse_cached_entry(struct cache *cache, struct cache_entry *entry,
 	}
 
 	cache->split = entry->prev;
-
-	++cache->hits.number;
 }
 
 /**  Evict an entry from the probe list.
@@ -230,6 +374,7 @@ static struct cache_entry *
 evict_probe(struct cache *cache, struct cache_search *cs)
 {
 	struct cache_entry *entry = &cache->ce[cs->uprobe];
+	unhash_entry(cache, entry);
 	if (entry->prev != cs->gprobe) {
 		if (cs->uprobe == cache->split)
 			cache->split = entry->prev;
@@ -250,6 +395,7 @@ static struct cache_entry *
 evict_prec(struct cache *cache, struct cache_search *cs)
 {
 	struct cache_entry *entry = &cache->ce[cs->uprec];
+	unhash_entry(cache, entry);
 	if (entry->next != cs->gprec) {
 		remove_entry(cache, entry);
 		add_entry_before(cache, entry, cs->uprec, cs->gprec);
@@ -319,8 +465,10 @@ get_missed_entry(struct cache *cache, cache_key_t key,
 			entry = &cache->ce[idx];
 			if (cache->ngprobe)
 				--cache->ngprobe;
-			else
+			else {
+				unhash_entry(cache, entry);
 				--cache->nprobe;
+			}
 			--cache->nprobetotal;
 		} else if (cache->ngprec)
 			   --cache->ngprec;
@@ -495,9 +643,10 @@ cache_get_entry_noref(struct cache *cache, cache_key_t key)
 		entry = &cache->ce[idx];
 		if (entry->key == key) {
 			reuse_cached_entry(cache, entry, idx);
+			count_event(&cache->top->hits);
 			return entry;
 		}
-		if (entry->refcnt == 0) {
+		if (__atomic_load_n(&entry->refcnt, __ATOMIC_ACQUIRE) == 0) {
 			cs.uprec = idx;
 			++cs.nuprec;
 		}
@@ -515,9 +664,10 @@ cache_get_entry_noref(struct cache *cache, cache_key_t key)
 			++cache->nprec;
 			--cache->nprobetotal;
 			reuse_cached_entry(cache, entry, idx);
+			count_event(&cache->top->hits);
 			return entry;
 		}
-		if (entry->refcnt == 0) {
+		if (__atomic_load_n(&entry->refcnt, __ATOMIC_ACQUIRE) == 0) {
 			cs.uprobe = idx;
 			++cs.nuprobe;
 		}
@@ -540,8 +690,346 @@ cache_get_entry_noref(struct cache *cache, cache_key_t key)
 	if (!entry)
 		entry = get_missed_entry(cache, key, &cs);
 
-	++cache->misses.number;
+	count_event(&cache->top->misses);
+
+	return entry;
+}
+
+/**  Return an unused in-flight entry to the unused pool.
+ *
+ * @param cache  Cache object (locked).
+ * @param entry  Cache entry.
+ */
+static void
+discard_entry(struct cache *cache, struct cache_entry *entry)
+{
+	unsigned n, idx, eprobe;
+
+	if (entry->state == cs_probe)
+		--cache->nprobetotal;
+
+	idx = entry - cache->ce;
+	if (cache->ninflight--) {
+		if (cache->inflight == idx)
+			cache->inflight = entry->next;
+		remove_entry(cache, entry);
+	}
+
+	n = cache->nprobe + cache->ngprobe;
+	eprobe = cache->split;
+	while (n--)
+		eprobe = cache->ce[eprobe].prev;
+
+	if (eprobe == cache->split)
+		cache->split = idx;
+
+	add_entry_after(cache, entry, idx, eprobe);
+}
+
+/**  Apply deferred lock-free hits.
+ *
+ * @param cache  Cache object (locked).
+ *
+ * Move all entries that have been marked as referenced by a lock-free
+ * lookup as if they were hit with the cache mutex held.
+ */
+static void
+apply_lockless_hits(struct cache *cache)
+{
+	struct cache_entry *entry;
+	unsigned n, idx, nextidx;
+
+	/* Promote referenced probed entries to the precious list */
+	n = cache->nprobe;
+	idx = cache->split;
+	while (n--) {
+		entry = &cache->ce[idx];
+		nextidx = entry->prev;
+		if (__atomic_exchange_n(&entry->referenced, 0,
+					__ATOMIC_RELAXED)) {
+			--cache->nprobe;
+			++cache->nprec;
+			--cache->nprobetotal;
+			reuse_cached_entry(cache, entry, idx);
+		}
+		idx = nextidx;
+	}
+
+	/* Move referenced precious entries to the MRU position */
+	n = cache->nprec;
+	idx = cache->ce[cache->split].next;
+	while (n--) {
+		entry = &cache->ce[idx];
+		nextidx = entry->next;
+		if (__atomic_exchange_n(&entry->referenced, 0,
+					__ATOMIC_RELAXED))
+			reuse_cached_entry(cache, entry, idx);
+		idx = nextidx;
+	}
+}
+
+/**  Free an elastic entry.
+ *
+ * @param cache  Cache object.
+ * @param entry  Elastic cache entry without any references.
+ */
+static void
+free_elastic(struct cache *cache, struct cache_entry *entry)
+{
+	if (cache_entry_valid(entry) && cache->entry_cleanup)
+		cache->entry_cleanup(cache->cleanup_data, entry);
+	free(entry);
+}
+
+/**  Allocate an elastic entry.
+ *
+ * @param cache  Cache object (locked).
+ * @param key    Requested key.
+ * @returns      A new in-flight entry, or @c NULL on allocation failure.
+ *
+ * The entry is not linked into the cache, so it cannot be found by
+ * other lookups, and it is freed when the last reference is dropped.
+ */
+static struct cache_entry *
+alloc_elastic(struct cache *cache, cache_key_t key)
+{
+	struct cache_entry *entry;
+
+	entry = malloc(sizeof(struct cache_entry) + cache->elemsize);
+	if (!entry)
+		return NULL;
+
+	entry->key = key;
+	entry->state = cs_probe;
+	entry->next = entry->prev = entry->hnext = NO_ENTRY;
+	entry->refcnt = 0;
+	entry->referenced = 0;
+	entry->elastic = 1;
+	entry->data = cache->elemsize ? entry + 1 : NULL;
+
+	count_event(&cache->top->misses);
+	return entry;
+}
+
+/**  Wake up threads waiting for a released entry.
+ *
+ * @param cache  Cache object (not locked).
+ *
+ * Call this function after dropping the last reference to an entry.
+ * The full barrier pairs with the one in @ref wait_for_entry: either
+ * the waiter sees the released entry, or this thread sees the waiter.
+ */
+static void
+wake_waiters(struct cache *cache)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&cache->nwaiters, __ATOMIC_RELAXED)) {
+		mutex_lock(&cache->mutex);
+		cond_broadcast(&cache->released);
+		mutex_unlock(&cache->mutex);
+	}
+}
+
+/**  Drop a reference and discard the entry if it is unused.
+ *
+ * @param cache  Cache object (not locked).
+ * @param entry  Cache entry.
+ */
+static void
+discard_unused(struct cache *cache, struct cache_entry *entry)
+{
+	mutex_lock(&cache->mutex);
+	if (!__atomic_sub_fetch(&entry->refcnt, 1, __ATOMIC_RELEASE)) {
+		if (entry->elastic)
+			free_elastic(cache, entry);
+		else if (!cache_entry_valid(entry))
+			discard_entry(cache, entry);
+		if (cache->nwaiters)
+			cond_broadcast(&cache->released);
+	}
+	mutex_unlock(&cache->mutex);
+}
+
+/**  Check whether an entry is in flight.
+ *
+ * @param cache  Cache object (locked).
+ * @param entry  Cache entry.
+ * @returns      Non-zero if @p entry is on the in-flight list.
+ */
+static int
+entry_inflight(struct cache *cache, struct cache_entry *entry)
+{
+	unsigned idx, n;
+
+	idx = cache->inflight;
+	for (n = cache->ninflight; n; --n) {
+		if (&cache->ce[idx] == entry)
+			return 1;
+		idx = cache->ce[idx].next;
+	}
+	return 0;
+}
+
+/**  Drop a reference taken by a failed lock-free lookup.
+ *
+ * @param cache  Cache object (not locked).
+ * @param entry  Cache entry.
+ *
+ * The entry may have been evicted and reused since it was found, and
+ * it may even have been discarded already, so it must not be discarded
+ * again. However, if it is still in flight, its owner may have dropped
+ * its reference while this thread was holding the speculative one. The
+ * owner then did not discard the entry, so it must be done here.
+ */
+static void
+put_speculative(struct cache *cache, struct cache_entry *entry)
+{
+	mutex_lock(&cache->mutex);
+	if (!__atomic_sub_fetch(&entry->refcnt, 1, __ATOMIC_RELEASE)) {
+		if (entry_inflight(cache, entry))
+			discard_entry(cache, entry);
+		if (cache->nwaiters)
+			cond_broadcast(&cache->released);
+	}
+	mutex_unlock(&cache->mutex);
+}
+
+/**  Wait until a cache entry can be allocated.
+ *
+ * @param cache  Cache object (locked).
+ * @param key    Requested key.
+ * @returns      Pointer to a cache entry, or @c NULL if waiting is
+ *               not possible.
+ *
+ * The number of waiters is incremented before searching the cache
+ * again, so a concurrent release cannot be missed.
+ *
+ * Waiting is safe only while some entries are in flight, because their
+ * owners release them as soon as the data is read. If all entries are
+ * valid and referenced, they may all be pinned by the calling thread,
+ * and waiting would never end. An elastic entry is allocated instead.
+ * This relies on the fact that no thread holds an in-flight entry while
+ * it requests another one.
+ */
+static struct cache_entry *
+wait_for_entry(struct cache *cache, cache_key_t key)
+{
+	struct cache_entry *entry;
+
+	__atomic_add_fetch(&cache->nwaiters, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while (!(entry = cache_get_entry_noref(cache, key))) {
+		int err;
+
+		if (!cache->ninflight) {
+			entry = alloc_elastic(cache, key);
+			break;
+		}
+
+		write_seqend(cache);
+		err = cond_wait(&cache->released, &cache->mutex);
+		write_seqbegin(cache);
+		if (err)
+			break;
+	}
+	__atomic_sub_fetch(&cache->nwaiters, 1, __ATOMIC_RELAXED);
+
+	return entry;
+}
+
+/**  Handle a lookup in a fully utilized cache.
+ *
+ * @param cache  Cache object (locked).
+ * @param key    Requested key.
+ * @returns      Pointer to a cache entry, or @c NULL.
+ */
+static struct cache_entry *
+get_entry_full(struct cache *cache, cache_key_t key)
+{
+	switch (cache->full_policy) {
+	case KDUMP_CACHE_FULL_WAIT:
+		return wait_for_entry(cache, key);
+
+	case KDUMP_CACHE_FULL_GROW:
+		return alloc_elastic(cache, key);
+
+	default:
+		return NULL;
+	}
+}
+
+/**  Look up a cached entry without holding the cache mutex.
+ *
+ * @param cache  Cache object.
+ * @param key    Key to be searched.
+ * @returns      Referenced cache entry, or @c NULL.
+ *
+ * This function returns only valid cached entries. If the entry is not
+ * found, or if the lookup races with a concurrent eviction, the caller
+ * must fall back to a search with the cache mutex held.
+ */
+static struct cache_entry *
+get_entry_lockless(struct cache *cache, cache_key_t key)
+{
+	struct cache_entry *entry;
+	unsigned seq, idx, n;
+
+	seq = __atomic_load_n(&cache->seq, __ATOMIC_ACQUIRE);
+	if (seq & 1)
+		return NULL;
+
+	entry = NULL;
+	idx = __atomic_load_n(&cache->hash[hash_index(cache, key)],
+			      __ATOMIC_ACQUIRE);
+	for (n = cache->cap; n && idx != NO_ENTRY; --n) {
+		struct cache_entry *cur = &cache->ce[idx];
+		if (cur->key == key) {
+			entry = cur;
+			break;
+		}
+		idx = __atomic_load_n(&cur->hnext, __ATOMIC_RELAXED);
+	}
+	if (!entry)
+		return NULL;
+
+	__atomic_add_fetch(&entry->refcnt, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&cache->seq, __ATOMIC_RELAXED) != seq) {
+		/* The entry may have been evicted and reused meanwhile. */
+		put_speculative(cache, entry);
+		return NULL;
+	}
+
+	if (!__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED)) {
+		__atomic_store_n(&entry->referenced, 1, __ATOMIC_RELAXED);
+		__atomic_store_n(&cache->hits_pending, 1, __ATOMIC_RELAXED);
+	}
+	count_event(&cache->top->hits);
+	return entry;
+}
+
+/**  Look up cached data without allocating a new entry.
+ *
+ * @param cache  Cache object.
+ * @param key    Key to be searched.
+ * @returns      Pointer to a valid cache entry, or @c NULL.
+ *
+ * Unlike @ref cache_get_entry, this function never evicts an entry
+ * and never takes the cache mutex. It may return @c NULL even if the
+ * key is in the cache, e.g. if the cache is being modified by another
+ * thread at the same time.
+ *
+ * The reference count of the returned entry is incremented.
+ */
+struct cache_entry *
+cache_lookup_entry(struct cache *cache, cache_key_t key)
+{
+	struct cache_entry *entry;
 
+	cache = key_shard(cache, key);
+	entry = get_entry_lockless(cache, key);
+	if (!entry)
+		count_event(&cache->top->misses);
 	return entry;
 }
 
@@ -556,6 +1044,10 @@ cache_get_entry_noref(struct cache *cache, cache_key_t key)
  * On a cache miss, the returned entry can be used to load data into the
  * cache and store it for later use with @ref cache_insert.
  *
+ * Cache hits are usually served without taking the cache mutex.
+ * If all entries are in use, the result depends on the cache full
+ * policy (see @ref set_cache_full_policy).
+ *
  * The reference count of the returned entry is incremented.
  */
 struct cache_entry *
@@ -563,29 +1055,40 @@ cache_get_entry(struct cache *cache, cache_key_t key)
 {
 	struct cache_entry *entry;
 
+	cache = key_shard(cache, key);
+	entry = get_entry_lockless(cache, key);
+	if (entry)
+		return entry;
+
+	mutex_lock(&cache->mutex);
+	write_seqbegin(cache);
+	if (__atomic_exchange_n(&cache->hits_pending, 0, __ATOMIC_RELAXED))
+		apply_lockless_hits(cache);
 	entry = cache_get_entry_noref(cache, key);
+	if (!entry)
+		entry = get_entry_full(cache, key);
 	if (entry)
-		++entry->refcnt;
+		__atomic_add_fetch(&entry->refcnt, 1, __ATOMIC_RELAXED);
+	write_seqend(cache);
+	mutex_unlock(&cache->mutex);
 
 	return entry;
 }
 
-/**  Insert an entry into the cache.
+/**  Insert an in-flight entry into the cache.
  *
- * @param cache  Cache object.
- * @param entry  Cache entry (with data).
- *
- * Note that this function does **NOT** drop the reference to @p entry.
- * This is necessary to allow callers inserting an entry to the cache as
- * soon as possible, while using the data afterwards.
+ * @param cache  Cache object (locked).
+ * @param entry  Cache entry.
  */
-void
-cache_insert(struct cache *cache, struct cache_entry *entry)
+static void
+insert_entry(struct cache *cache, struct cache_entry *entry)
 {
 	unsigned idx;
 
-	if (cache_entry_valid(entry))
+	if (entry->elastic) {
+		entry->state = cs_valid;
 		return;
+	}
 
 	idx = entry - cache->ce;
 	if (cache->ninflight--) {
@@ -594,6 +1097,8 @@ cache_insert(struct cache *cache, struct cache_entry *entry)
 		remove_entry(cache, entry);
 	}
 	add_entry_after(cache, entry, idx, cache->split);
+	entry->referenced = 0;
+	hash_entry(cache, entry, idx);
 
 	switch (entry->state) {
 	case cs_probe:
@@ -611,15 +1116,101 @@ cache_insert(struct cache *cache, struct cache_entry *entry)
 	entry->state = cs_valid;
 }
 
+/**  Insert an entry into the cache.
+ *
+ * @param cache  Cache object.
+ * @param entry  Cache entry (with data).
+ *
+ * Note that this function does **NOT** drop the reference to @p entry.
+ * This is necessary to allow callers inserting an entry to the cache as
+ * soon as possible, while using the data afterwards.
+ */
+void
+cache_insert(struct cache *cache, struct cache_entry *entry)
+{
+	cache = key_shard(cache, entry->key);
+	mutex_lock(&cache->mutex);
+	if (!cache_entry_valid(entry))
+		insert_entry(cache, entry);
+	mutex_unlock(&cache->mutex);
+}
+
+/**  Set entry data and insert the entry into the cache.
+ *
+ * @param cache  Cache object.
+ * @param entry  Cache entry (without data).
+ * @param data   New data pointer.
+ * @returns      Non-zero if @p data was stored in @p entry, zero if
+ *               the entry had been inserted by another caller already.
+ *
+ * This function is intended for caches which do not manage their own
+ * data buffers (i.e. allocated with a zero element size). Since data
+ * is loaded without holding the cache lock, more than one caller may
+ * load data for the same in-flight entry. Only the first one wins; the
+ * others must release any resources associated with their @p data.
+ */
+int
+cache_insert_data(struct cache *cache, struct cache_entry *entry,
+		  void *data)
+{
+	int ret;
+
+	cache = key_shard(cache, entry->key);
+	mutex_lock(&cache->mutex);
+	ret = !cache_entry_valid(entry);
+	if (ret) {
+		entry->data = data;
+		insert_entry(cache, entry);
+	}
+	mutex_unlock(&cache->mutex);
+	return ret;
+}
+
+/**  Copy data into an entry and insert the entry into the cache.
+ *
+ * @param cache  Cache object.
+ * @param entry  Cache entry.
+ * @param data   Data to be copied (of the cache element size).
+ *
+ * This is the counterpart of @ref cache_insert_data for caches which
+ * manage their own data buffers. If more than one caller loads data
+ * for the same in-flight entry, each of them must use a private buffer.
+ * The entry data is written only by the first caller, while the cache
+ * mutex is held, so readers never see partially written data.
+ */
+void
+cache_insert_copy(struct cache *cache, struct cache_entry *entry,
+		  const void *data)
+{
+	cache = key_shard(cache, entry->key);
+	mutex_lock(&cache->mutex);
+	if (!cache_entry_valid(entry)) {
+		memcpy(entry->data, data, cache->elemsize);
+		insert_entry(cache, entry);
+	}
+	mutex_unlock(&cache->mutex);
+}
+
 /**  Drop a reference to a cache entry.
  *
  * @param cache  Cache object.
  * @param entry  Cache entry.
+ *
+ * The reference count is updated atomically, so this function does
+ * not need to take the cache mutex unless another thread is waiting
+ * for an entry.
  */
 void
 cache_put_entry(struct cache *cache, struct cache_entry *entry)
 {
-	--entry->refcnt;
+	cache = key_shard(cache, entry->key);
+	if (__atomic_sub_fetch(&entry->refcnt, 1, __ATOMIC_RELEASE))
+		return;
+
+	if (entry->elastic)
+		free_elastic(cache, entry);
+	else
+		wake_waiters(cache);
 }
 
 /**  Discard an entry.
@@ -638,31 +1229,7 @@ cache_put_entry(struct cache *cache, struct cache_entry *entry)
 void
 cache_discard(struct cache *cache, struct cache_entry *entry)
 {
-	unsigned n, idx, eprobe;
-
-	if (--entry->refcnt)
-		return;
-	if (cache_entry_valid(entry))
-		return;
-	if (entry->state == cs_probe)
-		--cache->nprobetotal;
-
-	idx = entry - cache->ce;
-	if (cache->ninflight--) {
-		if (cache->inflight == idx)
-			cache->inflight = entry->next;
-		remove_entry(cache, entry);
-	}
-
-	n = cache->nprobe + cache->ngprobe;
-	eprobe = cache->split;
-	while (n--)
-		eprobe = cache->ce[eprobe].prev;
-
-	if (eprobe == cache->split)
-		cache->split = idx;
-
-	add_entry_after(cache, entry, idx, eprobe);
+	discard_unused(key_shard(cache, entry->key), entry);
 }
 
 /**  Clean up all cache entries.
@@ -708,14 +1275,28 @@ cache_flush(struct cache *cache)
 {
 	unsigned i, n;
 
+	if (cache->nshards) {
+		for (i = 0; i < cache->nshards; ++i)
+			cache_flush(cache->shards[i]);
+		return;
+	}
+
+	mutex_lock(&cache->mutex);
+	write_seqbegin(cache);
 	cleanup_entries(cache);
 
+	n = 1U << cache->hbits;
+	for (i = 0; i < n; ++i)
+		cache->hash[i] = NO_ENTRY;
+
 	n = 2 * cache->cap;
 	for (i = 0; i < n; ++i) {
 		struct cache_entry *entry = &cache->ce[i];
 		entry->next = (i > 0) ? (i - 1) : (n - 1);
 		entry->prev = (i < n - 1) ? (i + 1) : 0;
 		entry->refcnt = 0;
+		entry->referenced = 0;
+		entry->elastic = 0;
 		entry->data = i < cache->cap
 			? cache->data + i * cache->elemsize
 			: NULL;
@@ -729,6 +1310,9 @@ cache_flush(struct cache *cache)
 	cache->dprobe = 0;
 	cache->nprobetotal = 0;
 	cache->ninflight = 0;
+	cache->hits_pending = 0;
+	write_seqend(cache);
+	mutex_unlock(&cache->mutex);
 }
 
 /**  Allocate a cache object.
@@ -743,21 +1327,47 @@ struct cache *
 cache_alloc(unsigned n, size_t size)
 {
 	struct cache *cache;
+	unsigned hbits;
+
+	for (hbits = 1; hbits < 32 && (1U << hbits) < n; ++hbits)
+		;
 
 	cache = malloc(sizeof(struct cache) +
-		       2 * n * sizeof(struct cache_entry));
+		       2 * n * sizeof(struct cache_entry) +
+		       (sizeof(unsigned) << hbits));
 	if (!cache)
 		return cache;
 
+	cache->seq = 0;
+	cache->full_policy = KDUMP_CACHE_FULL_FAIL;
+	cache->nwaiters = 0;
+	cache->hbits = hbits;
+	cache->hmul = 1;
+	cache->hash = (unsigned *) &cache->ce[2 * n];
+	cache->top = cache;
+	cache->nshards = 0;
+	cache->shards = NULL;
 	cache->elemsize = size;
 	cache->cap = n;
 	cache->hits.number = 0;
 	cache->misses.number = 0;
 	cache->entry_cleanup = NULL;
 
+	if (mutex_init(&cache->mutex, NULL)) {
+		free(cache);
+		return NULL;
+	}
+	if (cond_init(&cache->released, NULL)) {
+		mutex_destroy(&cache->mutex);
+		free(cache);
+		return NULL;
+	}
+
 	if (cache->elemsize) {
 		cache->data = malloc(cache->cap * cache->elemsize);
 		if (!cache->data) {
+			cond_destroy(&cache->released);
+			mutex_destroy(&cache->mutex);
 			free(cache);
 			return NULL;
 		}
@@ -768,6 +1378,67 @@ cache_alloc(unsigned n, size_t size)
 	return cache;
 }
 
+/**  Allocate a sharded cache object.
+ *
+ * @param n        Total number of elements in the cache.
+ * @param size     Data size for each element.
+ * @param nshards  Number of shards.
+ * @returns        Newly allocated cache object, or @c NULL on failure.
+ *
+ * The elements are divided evenly among the shards. If @p n is not
+ * a multiple of @p nshards, the remainder is given to the first shards.
+ * Every shard has at least one element, so the total number of elements
+ * exceeds @p n if @p n is less than @p nshards.
+ * If @p nshards is less than two, this function is equivalent to
+ * @ref cache_alloc.
+ */
+struct cache *
+cache_alloc_sharded(unsigned n, size_t size, unsigned nshards)
+{
+	struct cache *cache;
+	unsigned shardsize;
+
+	if (nshards < 2)
+		return cache_alloc(n, size);
+
+	cache = malloc(sizeof(struct cache));
+	if (!cache)
+		return cache;
+
+	cache->shards = malloc(nshards * sizeof(struct cache *));
+	if (!cache->shards) {
+		free(cache);
+		return NULL;
+	}
+
+	cache->top = cache;
+	cache->full_policy = KDUMP_CACHE_FULL_FAIL;
+	cache->elemsize = size;
+	cache->cap = 0;
+	cache->hits.number = 0;
+	cache->misses.number = 0;
+	cache->entry_cleanup = NULL;
+
+	for (cache->nshards = 0; cache->nshards < nshards; ++cache->nshards) {
+		struct cache *shard;
+
+		shardsize = n / nshards + (cache->nshards < n % nshards);
+		if (!shardsize)
+			shardsize = 1;
+		shard = cache_alloc(shardsize, size);
+		if (!shard) {
+			cache_free(cache);
+			return NULL;
+		}
+		shard->top = cache;
+		shard->hmul = nshards;
+		cache->shards[cache->nshards] = shard;
+		cache->cap += shardsize;
+	}
+
+	return cache;
+}
+
 /** Set cache entry destructor.
  * @param cache  Cache object.
  * @param fn     Entry destructor, or @c NULL.
@@ -782,10 +1453,30 @@ void
 set_cache_entry_cleanup(struct cache *cache, cache_entry_cleanup_fn *fn,
 			void *data)
 {
+	unsigned i;
+
+	for (i = 0; i < cache->nshards; ++i)
+		set_cache_entry_cleanup(cache->shards[i], fn, data);
 	cache->entry_cleanup = fn;
 	cache->cleanup_data = data;
 }
 
+/** Set cache full policy.
+ * @param cache   Cache object.
+ * @param policy  What to do if all entries are in use.
+ *
+ * The caller must ensure that the cache is not used concurrently.
+ */
+void
+set_cache_full_policy(struct cache *cache, kdump_cache_full_policy_t policy)
+{
+	unsigned i;
+
+	for (i = 0; i < cache->nshards; ++i)
+		set_cache_full_policy(cache->shards[i], policy);
+	cache->full_policy = policy;
+}
+
 /**  Free a cache object.
  * @param cache  Cache object.
  *
@@ -796,9 +1487,19 @@ set_cache_entry_cleanup(struct cache *cache, cache_entry_cleanup_fn *fn,
 void
 cache_free(struct cache *cache)
 {
+	if (cache->shards) {
+		while (cache->nshards)
+			cache_free(cache->shards[--cache->nshards]);
+		free(cache->shards);
+		free(cache);
+		return;
+	}
+
 	cleanup_entries(cache);
 	if (cache->data != cache)
 		free(cache->data);
+	cond_destroy(&cache->released);
+	mutex_destroy(&cache->mutex);
 	free(cache);
 }
 
@@ -818,6 +1519,22 @@ get_cache_size(kdump_ctx_t *ctx)
 		: DEFAULT_CACHE_SIZE;
 }
 
+/**  Get the configured number of cache shards.
+ * @param ctx  Dump file object.
+ * @returns    Number of cache shards.
+ *
+ * Get the number of shards from "cache.shards" attribute. If not set,
+ * return @ref DEFAULT_CACHE_SHARDS.
+ */
+unsigned
+get_cache_shards(kdump_ctx_t *ctx)
+{
+	struct attr_data *attr = gattr(ctx, GKI_cache_shards);
+	return attr_isset(attr) && attr_revalidate(ctx, attr) == KDUMP_OK
+		? attr_value(attr)->number
+		: DEFAULT_CACHE_SHARDS;
+}
+
 /**  Set up cache statistics attributes.
  * @param cache   Cache object.
  * @param ctx     Dump file object containing the attributes.
@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <sys/mman.h>
 
 /** Maximum length of the static error message. */
 #define ERRBUF	160
@@ -75,16 +76,12 @@ alloc_shared(void)
 	list_init(&shared->ctx);
 
 	if (rwlock_init(&shared->lock, NULL))
-		goto err1;
-
-	if (mutex_init(&shared->cache_lock, NULL))
-		goto err2;
+		goto err;
 
 	shared->refcnt = 1;
 	return shared;
 
- err2:	rwlock_destroy(&shared->lock);
- err1:	free(shared);
+ err:	free(shared);
 	return NULL;
 }
 
@@ -106,7 +103,8 @@ shared_free(struct kdump_shared *shared)
 		cache_free(shared->cache);
 	if (shared->fcache)
 		fcache_decref(shared->fcache);
-	mutex_destroy(&shared->cache_lock);
+	if (shared->zero_page)
+		munmap(shared->zero_page, MAX_PAGE_SIZE);
 	rwlock_destroy(&shared->lock);
 	free(shared);
 }
@@ -155,7 +153,12 @@ kdump_new(void)
 	} numeric_attrs[] = {
 		{ GKI_cache_hits, 0 },
 		{ GKI_cache_misses, 0 },
+		{ GKI_zero_pages, 0 },
 		{ GKI_cache_size, DEFAULT_CACHE_SIZE },
+		{ GKI_cache_shards, DEFAULT_CACHE_SHARDS },
+		{ GKI_cache_full_policy, KDUMP_CACHE_FULL_FAIL },
+		{ GKI_cache_readahead, 0 },
+		{ GKI_cache_readahead_window, DEFAULT_READAHEAD_WINDOW },
 		{ GKI_file_mmap_policy, KDUMP_MMAP_TRY },
 		{ GKI_mmap_cache_hits, 0 },
 		{ GKI_mmap_cache_misses, 0 },
@@ -233,7 +236,7 @@ kdump_clone(const kdump_ctx_t *orig, unsigned long flags)
 		size_t sz = orig->shared->per_ctx_size[slot];
 		if (!sz)
 			continue;
-		if (! (ctx->data[slot] = malloc(sz)) ) {
+		if (! (ctx->data[slot] = calloc(1, sz)) ) {
 			while (slot-- > 0)
 				if (orig->shared->per_ctx_size[slot])
 					free(ctx->data[slot]);
@@ -327,14 +330,19 @@ kdump_get_addrxlat(kdump_ctx_t *ctx,
 /**  Allocate per-context data.
  * @param shared  Dump file shared data.
  * @param sz      Size of per-context data.
+ * @param cleanup Destructor for the per-context data, or @c NULL.
  * @returns       Per-context slot number, or -1 on error.
  *
+ * Per-context data is zero-initialized. If @p cleanup is non-NULL,
+ * it is called for each context's data before it is freed.
+ *
  * On error, @c errno is set to:
  * - @c EAGAIN  All slots are already in use.
  * - @c ENOMEM  Memory allocation failure.
  */
 int
-per_ctx_alloc(struct kdump_shared *shared, size_t sz)
+per_ctx_alloc(struct kdump_shared *shared, size_t sz,
+	      per_ctx_cleanup_fn *cleanup)
 {
 	kdump_ctx_t *ctx;
 	int slot;
@@ -348,10 +356,11 @@ per_ctx_alloc(struct kdump_shared *shared, size_t sz)
 		return -1;
 	}
 	shared->per_ctx_size[slot] = sz;
+	shared->per_ctx_cleanup[slot] = cleanup;
 
 	/* Allocate memory. */
 	list_for_each_entry(ctx, &shared->ctx, list)
-		if (! (ctx->data[slot] = malloc(sz)) ) {
+		if (! (ctx->data[slot] = calloc(1, sz)) ) {
 			while (ctx->list.prev != &shared->ctx) {
 				ctx = list_entry(ctx->list.prev,
 						 kdump_ctx_t, list);
@@ -374,8 +383,22 @@ per_ctx_free(struct kdump_shared *shared, int slot)
 	kdump_ctx_t *ctx;
 
 	list_for_each_entry(ctx, &shared->ctx, list)
-		free(ctx->data[slot]);
+		per_ctx_release(shared, slot, ctx->data[slot]);
 	shared->per_ctx_size[slot] = 0;
+	shared->per_ctx_cleanup[slot] = NULL;
+}
+
+/**  Release one context's per-context data.
+ * @param shared  Dump file shared data.
+ * @param slot    Per-context slot number.
+ * @param data    Per-context data of a single context.
+ */
+void
+per_ctx_release(struct kdump_shared *shared, int slot, void *data)
+{
+	if (shared->per_ctx_cleanup[slot])
+		shared->per_ctx_cleanup[slot](data);
+	free(data);
 }
 
 const char *
@@ -308,10 +308,8 @@ devmem_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 	++ce->refcnt;
 
 	ce->key = pio->addr.addr;
-	mutex_lock(&ctx->shared->cache_lock);
 	ret = fcache_get_chunk(ctx->shared->fcache, &pio->chunk,
 			       get_page_size(ctx), pio->addr.addr);
-	mutex_unlock(&ctx->shared->cache_lock);
 	if (ret != KDUMP_OK) {
 		--ce->refcnt;
 		return set_error(ctx, ret,
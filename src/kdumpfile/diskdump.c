@@ -42,6 +42,9 @@
 #if USE_SNAPPY
 # include <snappy-c.h>
 #endif
+#if USE_ZSTD
+# include <zstd.h>
+#endif
 
 #define SIG_LEN	8
 
@@ -161,70 +164,115 @@ struct pfn_rgn {
  */
 #define RGN_ALLOC_INC	1024
 
+/** Log2 of the number of PFNs covered by one region index entry. */
+#define RGN_INDEX_SHIFT	12
+
+/** Number of page descriptors in one descriptor cache block. */
+#define PD_BLOCK_DESCS	128
+
+/** Number of blocks in the page descriptor cache. */
+#define PD_CACHE_BLOCKS	64
+
+/** One file of a (possibly split) diskdump. */
+struct dd_file {
+	struct fcache *fcache;	/**< File cache. */
+
+	/** First PFN stored in this file. */
+	kdump_pfn_t start_pfn;
+	/** Last PFN stored in this file plus one. */
+	kdump_pfn_t end_pfn;
+	bool split;		/**< Non-zero if this is a split dump file. */
+
+	int32_t sub_hdr_size;	/**< Sub-header size in blocks. */
+	int32_t bitmap_blocks;	/**< Page bitmap size in blocks. */
+
+	off_t desc_off;		/**< File position of the first descriptor. */
+	unsigned long ndesc;	/**< Number of page descriptors in the file. */
+
+	/** Cache of decoded page descriptor blocks.
+	 * Cache keys are block numbers, i.e. descriptor index divided
+	 * by @ref PD_BLOCK_DESCS.
+	 */
+	struct cache *pdcache;
+};
+
 struct disk_dump_priv {
+	/** Dump files, sorted by @c start_pfn. */
+	struct dd_file *files;
+	unsigned nfiles;	 /**< Number of elements in @c files. */
+
 	struct pfn_rgn *pfn_rgn; /**< PFN region map. */
 	size_t pfn_rgn_num;	 /**< Number of elements in the map. */
 
+	/** Sidecar index.
+	 * If the index is mapped, @c pfn_rgn points into it.
+	 */
+	struct kdidx idx;
+
+	/** PFN region index.
+	 * Element @c i is the index of the first region which ends
+	 * above PFN <code>i << RGN_INDEX_SHIFT</code>. There is an
+	 * additional last element equal to @c pfn_rgn_num.
+	 */
+	size_t *rgn_index;
+	size_t rgn_index_num;	 /**< Number of index entries (w/o sentinel). */
+	int hint_slot;		 /**< Last-hit region per-context slot. */
+
 	/** Overridden methods for arch.page_size attribute. */
 	struct attr_override page_size_override;
 	int cbuf_slot;		/**< Compressed data per-context slot. */
+	int zlib_slot;		/**< Zlib decompression state slot. */
+	int zstd_slot;		/**< Zstd decompression context slot. */
 };
 
 struct setup_data {
 	kdump_ctx_t *ctx;
 	off_t note_off;
 	size_t note_sz;
+
+	const void *hdr;	/**< Dump header of the first file. */
+	int32_t header_version;	/**< Dump header version. */
+	bool hdr64;		/**< Non-zero for 64-bit header layout. */
+	struct dd_file *file;	/**< File whose headers are being read. */
 };
 
 /* flags */
 #define DUMP_DH_COMPRESSED_ZLIB	0x1	/* page is compressed with zlib */
 #define DUMP_DH_COMPRESSED_LZO	0x2	/* page is compressed with lzo */
 #define DUMP_DH_COMPRESSED_SNAPPY 0x4	/* page is compressed with snappy */
+#define DUMP_DH_COMPRESSED_ZSTD	0x20	/* page is compressed with zstd */
 
 /* Any compression flag */
 #define DUMP_DH_COMPRESSED	( 0	\
 	| DUMP_DH_COMPRESSED_ZLIB	\
 	| DUMP_DH_COMPRESSED_LZO	\
 	| DUMP_DH_COMPRESSED_SNAPPY	\
+	| DUMP_DH_COMPRESSED_ZSTD	\
 		)
 
 static void diskdump_cleanup(struct kdump_shared *shared);
 
-/** Add a new PFN region.
- * @param ctx  Dump file context.
- * @param rgn  PFN region.
- * @returns    Error status.
- */
-static kdump_status
-add_pfn_rgn(kdump_ctx_t *ctx, const struct pfn_rgn *rgn)
-{
-	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
-
-	if (ddp->pfn_rgn_num % RGN_ALLOC_INC == 0) {
-		size_t num = ddp->pfn_rgn_num + RGN_ALLOC_INC;
-		struct pfn_rgn *rgn =
-			realloc(ddp->pfn_rgn, num * sizeof(struct pfn_rgn));
-		if (!rgn)
-			return set_error(ctx, KDUMP_ERR_SYSTEM,
-					 "Cannot allocate space for"
-					 " %zu PFN region mappings", num);
-		ddp->pfn_rgn = rgn;
-	}
-
-	ddp->pfn_rgn[ddp->pfn_rgn_num++] = *rgn;
-	return KDUMP_OK;
-}
-
 /** Find a PFN region by PFN.
  * @param ddp  Diskdump private data.
  * @param pfn  Page frame number.
  * @returns    Pointer to a PFN region which contains @c pfn or a closest
  *             higher PFN, or @c NULL if there is no such region.
+ *
+ * The region index narrows the search to the regions which overlap
+ * the same @c RGN_INDEX_SHIFT bucket, so the binary search touches
+ * only a small, contiguous part of the region map.
  */
 static const struct pfn_rgn *
 find_pfn_rgn(struct disk_dump_priv *ddp, kdump_pfn_t pfn)
 {
-	size_t left = 0, right = ddp->pfn_rgn_num;
+	kdump_pfn_t bucket = pfn >> RGN_INDEX_SHIFT;
+	size_t left, right;
+
+	if (bucket >= ddp->rgn_index_num)
+		return NULL;
+
+	left = ddp->rgn_index[bucket];
+	right = ddp->rgn_index[bucket + 1];
 	while (left != right) {
 		size_t mid = (left + right) / 2;
 		const struct pfn_rgn *rgn = ddp->pfn_rgn + mid;
@@ -240,13 +288,102 @@ find_pfn_rgn(struct disk_dump_priv *ddp, kdump_pfn_t pfn)
 		: NULL;
 }
 
+/** Check whether a PFN region contains a given PFN.
+ * @param rgn  PFN region.
+ * @param pfn  Page frame number.
+ * @returns    Non-zero if @p pfn is inside @p rgn.
+ */
+static inline int
+rgn_contains(const struct pfn_rgn *rgn, kdump_pfn_t pfn)
+{
+	return pfn >= rgn->pfn && pfn - rgn->pfn < rgn->cnt;
+}
+
+/** Find the dump file which stores a given PFN.
+ * @param ddp  Diskdump private data.
+ * @param pfn  Page frame number.
+ * @returns    The last file which starts at or below @p pfn.
+ *
+ * Split dumps are usually made of only a few files, so a linear
+ * search is good enough here.
+ */
+static struct dd_file *
+pfn_file(struct disk_dump_priv *ddp, kdump_pfn_t pfn)
+{
+	struct dd_file *file = ddp->files + ddp->nfiles - 1;
+
+	while (file > ddp->files && pfn < file->start_pfn)
+		--file;
+	return file;
+}
+
+/** Get the file position of a page descriptor.
+ * @param ctx  Dump file object.
+ * @param pfn  Page frame number.
+ * @returns    File position of the descriptor, or -1 if @p pfn
+ *             is not stored in the dump file.
+ *
+ * The last region found by this context is tried first, followed by
+ * the next region, so sequential reads usually avoid the search.
+ */
 static off_t
-pfn_to_pdpos(struct disk_dump_priv *ddp, unsigned long pfn)
+pfn_to_pdpos(kdump_ctx_t *ctx, kdump_pfn_t pfn)
 {
-	const struct pfn_rgn *rgn = find_pfn_rgn(ddp, pfn);
-	return rgn && pfn >= rgn->pfn
-		? rgn->pos + (pfn - rgn->pfn) * sizeof(struct page_desc)
-		: (off_t) -1;
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	size_t *hint = ctx->data[ddp->hint_slot];
+	const struct pfn_rgn *rgn;
+
+	if (*hint < ddp->pfn_rgn_num &&
+	    rgn_contains(rgn = &ddp->pfn_rgn[*hint], pfn))
+		goto found;
+	if (*hint + 1 < ddp->pfn_rgn_num &&
+	    rgn_contains(rgn = &ddp->pfn_rgn[*hint + 1], pfn))
+		goto found;
+
+	rgn = find_pfn_rgn(ddp, pfn);
+	if (!rgn || pfn < rgn->pfn)
+		return (off_t) -1;
+
+ found:
+	*hint = rgn - ddp->pfn_rgn;
+	return rgn->pos + (pfn - rgn->pfn) * sizeof(struct page_desc);
+}
+
+/** Build the PFN region index.
+ * @param ctx  Dump file object.
+ * @returns    Error status.
+ *
+ * This function must be called after the PFN region map is complete.
+ */
+static kdump_status
+build_rgn_index(kdump_ctx_t *ctx)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	const struct pfn_rgn *last;
+	size_t bucket, num, i;
+
+	if (ddp->pfn_rgn_num) {
+		last = &ddp->pfn_rgn[ddp->pfn_rgn_num - 1];
+		num = ((last->pfn + last->cnt - 1) >> RGN_INDEX_SHIFT) + 1;
+	} else
+		num = 0;
+
+	ddp->rgn_index = malloc((num + 1) * sizeof(size_t));
+	if (!ddp->rgn_index)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate PFN region index");
+
+	i = 0;
+	for (bucket = 0; bucket < num; ++bucket) {
+		kdump_pfn_t pfn = (kdump_pfn_t)bucket << RGN_INDEX_SHIFT;
+		while (ddp->pfn_rgn[i].pfn + ddp->pfn_rgn[i].cnt <= pfn)
+			++i;
+		ddp->rgn_index[bucket] = i;
+	}
+	ddp->rgn_index[num] = ddp->pfn_rgn_num;
+	ddp->rgn_index_num = num;
+
+	return KDUMP_OK;
 }
 
 static kdump_status
@@ -358,10 +495,140 @@ static const struct kdump_bmp_ops diskdump_bmp_ops = {
 	.cleanup = diskdump_bmp_cleanup,
 };
 
+#if USE_ZSTD
+/**  Free a zstd decompression context.
+ * @param data  Per-context data (pointer to @c ZSTD_DCtx pointer).
+ */
+static void
+free_zstd_dctx(void *data)
+{
+	ZSTD_DCtx **pdctx = data;
+	ZSTD_freeDCtx(*pdctx);
+}
+
+/**  Uncompress a zstd-compressed page.
+ * @param ctx     Dump file object.
+ * @param dst     Destination buffer (page-sized).
+ * @param src     Compressed data.
+ * @param srclen  Length of compressed data.
+ * @returns       Error status.
+ *
+ * The decompression context is allocated on first use and kept in
+ * per-context data, so it is reused for subsequent pages.
+ */
+static kdump_status
+uncompress_page_zstd(kdump_ctx_t *ctx, unsigned char *dst,
+		     unsigned char *src, size_t srclen)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	ZSTD_DCtx **pdctx = ctx->data[ddp->zstd_slot];
+	size_t retlen;
+
+	if (!*pdctx) {
+		*pdctx = ZSTD_createDCtx();
+		if (!*pdctx)
+			return set_error(ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot allocate zstd context");
+	}
+
+	retlen = ZSTD_decompressDCtx(*pdctx, dst, get_page_size(ctx),
+				     src, srclen);
+	if (ZSTD_isError(retlen))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Decompression failed: %s",
+				 ZSTD_getErrorName(retlen));
+	if (retlen != get_page_size(ctx))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Wrong uncompressed size: %lu",
+				 (unsigned long) retlen);
+	return KDUMP_OK;
+}
+#endif
+
+/**  Convert a page descriptor from dump byte order.
+ * @param ctx  Dump file object.
+ * @param pd   Page descriptor (updated in place).
+ */
+static void
+decode_page_desc(kdump_ctx_t *ctx, struct page_desc *pd)
+{
+	pd->offset = dump64toh(ctx, pd->offset);
+	pd->size = dump32toh(ctx, pd->size);
+	pd->flags = dump32toh(ctx, pd->flags);
+	pd->page_flags = dump64toh(ctx, pd->page_flags);
+}
+
+/**  Read a page descriptor.
+ * @param ctx     Dump file object.
+ * @param file    Dump file which contains the descriptor.
+ * @param pd_pos  File position of the page descriptor.
+ * @param pd      Page descriptor, filled on success.
+ * @returns       Error status.
+ *
+ * Descriptors are read and decoded in blocks of @ref PD_BLOCK_DESCS.
+ * Neighbouring pages have adjacent descriptors, so most page reads
+ * find their descriptor in the cache and need only one read from
+ * the file (for the page data).
+ *
+ * Another thread may be loading the same block concurrently, so the
+ * block is read and decoded in a private buffer, and it is copied to
+ * the cache entry only when the entry is inserted.
+ */
+static kdump_status
+read_page_desc(kdump_ctx_t *ctx, struct dd_file *file, off_t pd_pos,
+	       struct page_desc *pd)
+{
+	struct page_desc buf[PD_BLOCK_DESCS];
+	unsigned long idx, first, n;
+	struct cache_entry *ce;
+	struct page_desc *blk;
+	off_t pos;
+	kdump_status ret;
+
+	idx = (pd_pos - file->desc_off) / sizeof(struct page_desc);
+	ce = cache_get_entry(file->pdcache, idx / PD_BLOCK_DESCS);
+	if (!ce) {
+		/* All blocks are in use; read a single descriptor. */
+		ret = fcache_pread(file->fcache, pd, sizeof *pd, pd_pos);
+		if (ret != KDUMP_OK)
+			return set_error(ctx, ret,
+					 "Cannot read page descriptor at %llu",
+					 (unsigned long long) pd_pos);
+		decode_page_desc(ctx, pd);
+		return KDUMP_OK;
+	}
+
+	blk = ce->data;
+	if (!cache_entry_valid(ce)) {
+		first = idx - idx % PD_BLOCK_DESCS;
+		n = file->ndesc - first;
+		if (n > PD_BLOCK_DESCS)
+			n = PD_BLOCK_DESCS;
+		pos = file->desc_off + first * sizeof(struct page_desc);
+		ret = fcache_pread(file->fcache, buf,
+				   n * sizeof(struct page_desc), pos);
+		if (ret != KDUMP_OK) {
+			cache_discard(file->pdcache, ce);
+			return set_error(ctx, ret,
+					 "Cannot read page descriptors at %llu",
+					 (unsigned long long) pos);
+		}
+		memset(buf + n, 0, (PD_BLOCK_DESCS - n) * sizeof *buf);
+		while (n--)
+			decode_page_desc(ctx, &buf[n]);
+		cache_insert_copy(file->pdcache, ce, buf);
+	}
+
+	*pd = blk[idx % PD_BLOCK_DESCS];
+	cache_put_entry(file->pdcache, ce);
+	return KDUMP_OK;
+}
+
 static kdump_status
 diskdump_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 {
 	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	struct dd_file *file;
 	kdump_pfn_t pfn;
 	struct page_desc pd;
 	off_t pd_pos;
@@ -372,27 +639,14 @@ diskdump_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 	if (pfn >= get_max_pfn(ctx))
 		return set_error(ctx, KDUMP_ERR_NODATA, "Out-of-bounds PFN");
 
-	pd_pos = pfn_to_pdpos(ddp, pfn);
-	if (pd_pos == (off_t)-1) {
-		if (get_zero_excluded(ctx)) {
-			memset(pio->chunk.data, 0, get_page_size(ctx));
-			return KDUMP_OK;
-		}
+	pd_pos = pfn_to_pdpos(ctx, pfn);
+	if (pd_pos == (off_t)-1)
 		return set_error(ctx, KDUMP_ERR_NODATA, "Excluded page");
-	}
 
-	mutex_lock(&ctx->shared->cache_lock);
-	ret = fcache_pread(ctx->shared->fcache, &pd, sizeof pd, pd_pos);
-	mutex_unlock(&ctx->shared->cache_lock);
+	file = pfn_file(ddp, pfn);
+	ret = read_page_desc(ctx, file, pd_pos, &pd);
 	if (ret != KDUMP_OK)
-		return set_error(ctx, ret,
-				 "Cannot read page descriptor at %llu",
-				 (unsigned long long) pd_pos);
-
-	pd.offset = dump64toh(ctx, pd.offset);
-	pd.size = dump32toh(ctx, pd.size);
-	pd.flags = dump32toh(ctx, pd.flags);
-	pd.page_flags = dump64toh(ctx, pd.page_flags);
+		return ret;
 
 	if (pd.flags & DUMP_DH_COMPRESSED) {
 		if (pd.size > MAX_PAGE_SIZE)
@@ -409,16 +663,15 @@ diskdump_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 	}
 
 	/* read page data */
-	mutex_lock(&ctx->shared->cache_lock);
-	ret = fcache_pread(ctx->shared->fcache, buf, pd.size, pd.offset);
-	mutex_unlock(&ctx->shared->cache_lock);
+	ret = fcache_pread(file->fcache, buf, pd.size, pd.offset);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page data at %llu",
 				 (unsigned long long) pd.offset);
 
 	if (pd.flags & DUMP_DH_COMPRESSED_ZLIB) {
-		ret = uncompress_page_gzip(ctx, pio->chunk.data, buf, pd.size);
+		ret = uncompress_page_gzip(ctx, ddp->zlib_slot,
+					   pio->chunk.data, buf, pd.size);
 		if (ret != KDUMP_OK)
 			return ret;
 	} else if (pd.flags & DUMP_DH_COMPRESSED_LZO) {
@@ -458,6 +711,16 @@ diskdump_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 		return set_error(ctx, KDUMP_ERR_NOTIMPL,
 				 "Unsupported compression method: %s",
 				 "snappy");
+#endif
+	} else if (pd.flags & DUMP_DH_COMPRESSED_ZSTD) {
+#if USE_ZSTD
+		ret = uncompress_page_zstd(ctx, pio->chunk.data, buf, pd.size);
+		if (ret != KDUMP_OK)
+			return ret;
+#else
+		return set_error(ctx, KDUMP_ERR_NOTIMPL,
+				 "Unsupported compression method: %s",
+				 "zstd");
 #endif
 	}
 
@@ -467,6 +730,16 @@ diskdump_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 static kdump_status
 diskdump_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 {
+	kdump_pfn_t pfn;
+
+	/* Excluded pages do not need a cache entry. */
+	if (get_zero_excluded(ctx)) {
+		pfn = pio->addr.addr >> get_page_shift(ctx);
+		if (pfn < get_max_pfn(ctx) &&
+		    pfn_to_pdpos(ctx, pfn) == (off_t)-1)
+			return get_zero_page(ctx, pio);
+	}
+
 	return cache_get_page(ctx, pio, diskdump_read_page);
 }
 
@@ -486,7 +759,8 @@ diskdump_realloc_compressed(kdump_ctx_t *ctx, struct attr_data *attr)
 	struct disk_dump_priv *ddp;
 	int newslot;
 
-	newslot = per_ctx_alloc(ctx->shared, attr_value(attr)->number);
+	newslot = per_ctx_alloc(ctx->shared, attr_value(attr)->number,
+				NULL);
 	if (newslot < 0)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate buffer for compressed data");
@@ -558,66 +832,291 @@ read_notes(kdump_ctx_t *ctx, off_t off, size_t size)
 	return ret;
 }
 
-static kdump_pfn_t
-skip_clear(unsigned char *bitmap, size_t size, kdump_pfn_t pfn)
+/**  Get one 64-bit word of a page bitmap.
+ * @param bitmap  Page bitmap.
+ * @param idx     Word index.
+ * @returns       Bitmap word (bit 0 is the lowest PFN).
+ */
+static inline uint64_t
+bitmap_word(const unsigned char *bitmap, size_t idx)
 {
-	unsigned char *bp = bitmap + (pfn >> 3);
-	int lead;
+	uint64_t word;
 
-	if (bp >= bitmap + size)
-		return pfn;
+	memcpy(&word, bitmap + idx * sizeof word, sizeof word);
+	return le64toh(word);
+}
 
-	lead = ffs(*bp >> (pfn & 7));
-	if (lead)
-		return pfn + lead - 1;
+/**  Find the next set bit in a page bitmap.
+ * @param bitmap  Page bitmap.
+ * @param size    Size of @p bitmap in bytes (a multiple of 8).
+ * @param pfn     Starting PFN (relative to the start of @p bitmap).
+ * @returns       First PFN at or above @p pfn whose bit is set,
+ *                or the PFN just past the end of @p bitmap.
+ */
+static kdump_pfn_t
+skip_clear(const unsigned char *bitmap, size_t size, kdump_pfn_t pfn)
+{
+	size_t nwords = size / sizeof(uint64_t);
+	size_t idx = pfn / 64;
+	uint64_t word;
 
-	pfn = (pfn | 7) + 1;
-	++bp;
-	while (bp < bitmap + size && *bp == 0x00)
-		pfn += 8, ++bp;
-	if (bp < bitmap + size)
-		pfn += ffs(*bp) - 1;
+	if (idx >= nwords)
+		return pfn;
 
-	return pfn;
+	word = bitmap_word(bitmap, idx) & (~(uint64_t)0 << (pfn % 64));
+	while (!word) {
+		if (++idx >= nwords)
+			return (kdump_pfn_t)idx * 64;
+		word = bitmap_word(bitmap, idx);
+	}
+	return (kdump_pfn_t)idx * 64 + __builtin_ctzll(word);
 }
 
+/**  Find the next clear bit in a page bitmap.
+ * @param bitmap  Page bitmap.
+ * @param size    Size of @p bitmap in bytes (a multiple of 8).
+ * @param pfn     Starting PFN (relative to the start of @p bitmap).
+ * @returns       First PFN at or above @p pfn whose bit is clear,
+ *                or the PFN just past the end of @p bitmap.
+ */
 static kdump_pfn_t
-skip_set(unsigned char *bitmap, size_t size, kdump_pfn_t pfn)
+skip_set(const unsigned char *bitmap, size_t size, kdump_pfn_t pfn)
 {
-	unsigned char *bp = bitmap + (pfn >> 3);
-	int lead;
+	size_t nwords = size / sizeof(uint64_t);
+	size_t idx = pfn / 64;
+	uint64_t word;
 
-	if (bp >= bitmap + size)
+	if (idx >= nwords)
 		return pfn;
 
-	lead = ffs(~((signed char)*bp >> (pfn & 7)));
-	if (lead)
-		return pfn + lead - 1;
+	word = ~bitmap_word(bitmap, idx) & (~(uint64_t)0 << (pfn % 64));
+	while (!word) {
+		if (++idx >= nwords)
+			return (kdump_pfn_t)idx * 64;
+		word = ~bitmap_word(bitmap, idx);
+	}
+	return (kdump_pfn_t)idx * 64 + __builtin_ctzll(word);
+}
+
+/** Minimum bitmap size (in bytes) to be parsed by multiple threads. */
+#define BITMAP_PARALLEL_MIN	(1UL << 20)
+
+/** Maximum number of threads used to parse the page bitmap. */
+#define BITMAP_MAX_THREADS	8
+
+/** Page bitmap parsing state of one chunk. */
+struct bitmap_chunk {
+	const unsigned char *bitmap; /**< Start of this chunk's bitmap. */
+	size_t size;		/**< Size of the chunk in bytes. */
+	kdump_pfn_t pfn;	/**< PFN of the first bit in the chunk. */
+
+	/** Regions found in this chunk.
+	 * The @c pos field is not set; file positions are assigned
+	 * after all chunks are parsed.
+	 */
+	struct pfn_rgn *rgn;
+	size_t nrgn;		/**< Number of elements in @c rgn. */
+	bool nomem;		/**< Set if @c rgn could not be enlarged. */
+	bool running;		/**< Set if parsed by a separate thread. */
+	thread_t thread;	/**< Parsing thread (if @c running). */
+};
+
+/**  Find all PFN regions in one bitmap chunk.
+ * @param arg  Bitmap chunk (@ref bitmap_chunk).
+ * @returns    Always @c NULL.
+ *
+ * This function can be used as a thread start routine.
+ */
+static void *
+parse_bitmap_chunk(void *arg)
+{
+	struct bitmap_chunk *chunk = arg;
+	kdump_pfn_t end = (kdump_pfn_t)chunk->size * 8;
+	kdump_pfn_t first, pfn;
+
+	pfn = 0;
+	while (pfn < end) {
+		first = skip_clear(chunk->bitmap, chunk->size, pfn);
+		pfn = skip_set(chunk->bitmap, chunk->size, first);
+		if (pfn == first)
+			continue;
+
+		if (chunk->nrgn % RGN_ALLOC_INC == 0) {
+			size_t num = chunk->nrgn + RGN_ALLOC_INC;
+			struct pfn_rgn *rgn =
+				realloc(chunk->rgn, num * sizeof *rgn);
+			if (!rgn) {
+				chunk->nomem = true;
+				break;
+			}
+			chunk->rgn = rgn;
+		}
+		chunk->rgn[chunk->nrgn].pfn = chunk->pfn + first;
+		chunk->rgn[chunk->nrgn].cnt = pfn - first;
+		++chunk->nrgn;
+	}
+
+	return NULL;
+}
+
+/**  Get the number of threads for parsing a page bitmap.
+ * @param bitmapsize  Size of the bitmap in bytes.
+ * @returns           Number of bitmap chunks.
+ */
+static unsigned
+bitmap_nchunks(size_t bitmapsize)
+{
+	long ncpus;
 
-	pfn = (pfn | 7) + 1;
-	++bp;
-	while (bp < bitmap + size && *bp == 0xff)
-		pfn += 8, ++bp;
-	if (bp < bitmap + size)
-		pfn += ffs(~(signed char)*bp) - 1;
+	if (bitmapsize < BITMAP_PARALLEL_MIN)
+		return 1;
 
-	return pfn;
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ncpus < 1)
+		return 1;
+	return ncpus < BITMAP_MAX_THREADS ? ncpus : BITMAP_MAX_THREADS;
 }
 
+/**  Add the PFN regions of one dump file from its page bitmap.
+ * @param ctx         Dump file object.
+ * @param file        Dump file.
+ * @param bitmap      Page bitmap.
+ * @param bitmapsize  Size of @p bitmap in bytes (a multiple of 8).
+ * @returns           Error status.
+ *
+ * Only the part of the bitmap between @c start_pfn and @c end_pfn of
+ * @p file is used. Large bitmaps are split into chunks, which are
+ * parsed in parallel. The per-chunk regions are then merged, joining
+ * regions that span a chunk boundary, and file positions of the
+ * descriptors are assigned in PFN order. The resulting regions are
+ * appended to the PFN region map, so files must be added in order.
+ */
 static kdump_status
-read_bitmap(kdump_ctx_t *ctx, int32_t sub_hdr_size,
-	    int32_t bitmap_blocks)
+parse_bitmap(kdump_ctx_t *ctx, struct dd_file *file,
+	     const unsigned char *bitmap, size_t bitmapsize)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	struct bitmap_chunk chunks[BITMAP_MAX_THREADS];
+	struct bitmap_chunk *chunk;
+	struct pfn_rgn *rgn, *prev;
+	kdump_pfn_t start, end, lo, hi;
+	unsigned nchunks, i;
+	size_t chunksz, num, j;
+	unsigned long ndesc;
+	kdump_status ret;
+
+	file->ndesc = 0;
+	start = file->start_pfn;
+	end = (kdump_pfn_t)bitmapsize * 8;
+	if (file->end_pfn < end)
+		end = file->end_pfn;
+	if (start >= end)
+		return KDUMP_OK;
+
+	/* Parse only the whole words which cover this file. */
+	bitmap += start / 64 * sizeof(uint64_t);
+	bitmapsize = ((end + 63) / 64 - start / 64) * sizeof(uint64_t);
+
+	nchunks = bitmap_nchunks(bitmapsize);
+	chunksz = (bitmapsize / nchunks) & ~(sizeof(uint64_t) - 1);
+
+	memset(chunks, 0, sizeof chunks);
+	for (i = 0; i < nchunks; ++i) {
+		chunk = &chunks[i];
+		chunk->bitmap = bitmap + i * chunksz;
+		chunk->size = (i < nchunks - 1)
+			? chunksz
+			: bitmapsize - i * chunksz;
+		chunk->pfn = start / 64 * 64 + (kdump_pfn_t)i * chunksz * 8;
+		/* Parse the first chunk in this thread. */
+		if (i && !thread_create(&chunk->thread,
+					parse_bitmap_chunk, chunk))
+			chunk->running = true;
+	}
+
+	for (i = 0; i < nchunks; ++i) {
+		chunk = &chunks[i];
+		if (chunk->running)
+			thread_join(chunk->thread, NULL);
+		else
+			parse_bitmap_chunk(chunk);
+	}
+
+	ret = KDUMP_OK;
+	num = 0;
+	for (i = 0; i < nchunks; ++i) {
+		if (chunks[i].nomem)
+			ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+					"Cannot allocate space for"
+					" PFN region mappings");
+		num += chunks[i].nrgn;
+	}
+	if (ret != KDUMP_OK || !num)
+		goto out;
+
+	num += ddp->pfn_rgn_num;
+	rgn = realloc(ddp->pfn_rgn, num * sizeof(struct pfn_rgn));
+	if (!rgn) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate space for"
+				" %zu PFN region mappings", num);
+		goto out;
+	}
+	ddp->pfn_rgn = rgn;
+
+	prev = NULL;
+	ndesc = 0;
+	for (i = 0; i < nchunks; ++i) {
+		chunk = &chunks[i];
+		for (j = 0; j < chunk->nrgn; ++j) {
+			rgn = &chunk->rgn[j];
+			lo = rgn->pfn < start ? start : rgn->pfn;
+			hi = rgn->pfn + rgn->cnt;
+			if (hi > end)
+				hi = end;
+			if (lo >= hi)
+				continue;
+
+			if (prev && prev->pfn + prev->cnt == lo) {
+				prev->cnt += hi - lo;
+			} else {
+				prev = &ddp->pfn_rgn[ddp->pfn_rgn_num++];
+				prev->pfn = lo;
+				prev->cnt = hi - lo;
+				prev->pos = file->desc_off +
+					ndesc * sizeof(struct page_desc);
+			}
+			ndesc += hi - lo;
+		}
+	}
+	file->ndesc = ndesc;
+
+ out:
+	for (i = 0; i < nchunks; ++i)
+		free(chunks[i].rgn);
+	return ret;
+}
+
+/**  Get the location of a page bitmap.
+ * @param ctx    Dump file object.
+ * @param file   Dump file.
+ * @param poff   Set to the file position of the bitmap.
+ * @param psize  Set to the size of the bitmap in bytes.
+ *
+ * This function also sets the file position of the first page
+ * descriptor, and it lowers the maximum PFN if the bitmap is
+ * too small.
+ */
+static void
+bitmap_location(kdump_ctx_t *ctx, struct dd_file *file,
+		off_t *poff, size_t *psize)
 {
-	off_t off = (1 + sub_hdr_size) * get_page_size(ctx);
-	off_t descoff;
+	int32_t bitmap_blocks = file->bitmap_blocks;
+	off_t off = (1 + file->sub_hdr_size) * get_page_size(ctx);
 	size_t bitmapsize;
 	kdump_pfn_t max_bitmap_pfn;
-	kdump_pfn_t pfn;
-	struct pfn_rgn rgn;
-	struct fcache_chunk fch;
-	kdump_status ret;
 
-	descoff = off + bitmap_blocks * get_page_size(ctx);
+	file->desc_off = off + bitmap_blocks * get_page_size(ctx);
 
 	bitmapsize = bitmap_blocks * get_page_size(ctx);
 	max_bitmap_pfn = (kdump_pfn_t)bitmapsize * 8;
@@ -632,34 +1131,138 @@ read_bitmap(kdump_ctx_t *ctx, int32_t sub_hdr_size,
 	if (get_max_pfn(ctx) > max_bitmap_pfn)
 		set_max_pfn(ctx, max_bitmap_pfn);
 
-	ret = fcache_get_chunk(ctx->shared->fcache, &fch, bitmapsize, off);
+	*poff = off;
+	*psize = bitmapsize;
+}
+
+static kdump_status
+read_bitmap(kdump_ctx_t *ctx, struct dd_file *file)
+{
+	off_t off;
+	size_t bitmapsize;
+	struct fcache_chunk fch;
+	kdump_status ret;
+
+	bitmap_location(ctx, file, &off, &bitmapsize);
+	ret = fcache_get_chunk(file->fcache, &fch, bitmapsize, off);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read %zu bytes of page bitmap"
 				 " at %llu",
 				 bitmapsize, (unsigned long long) off);
 
-	rgn.pos = descoff;
-	pfn = 0;
-	while (pfn < max_bitmap_pfn) {
-		rgn.pfn = skip_clear(fch.data, bitmapsize, pfn);
-		pfn = skip_set(fch.data, bitmapsize, rgn.pfn);
-		rgn.cnt = pfn - rgn.pfn;
-		if (rgn.cnt) {
-			ret = add_pfn_rgn(ctx, &rgn);
-			if (ret != KDUMP_OK)
-				goto out;
-			rgn.pos += rgn.cnt * sizeof(struct page_desc);
-		}
-	}
+	ret = parse_bitmap(ctx, file, fch.data, bitmapsize);
 
-	ret = KDUMP_OK;
-
- out:
 	fcache_put_chunk(&fch);
 	return ret;
 }
 
+/**  Check a PFN region map loaded from the sidecar index.
+ * @param ctx    Dump file object.
+ * @param file   Dump file.
+ * @param rgn    PFN regions.
+ * @param num    Number of elements in @p rgn.
+ * @param ndesc  Number of page descriptors.
+ * @returns      Non-zero if the map is consistent with @p file.
+ *
+ * The regions must be sorted, they must not overlap, and they must not
+ * go beyond the maximum PFN. Page descriptors of all regions must be
+ * stored one after another in the descriptor area, in the same order
+ * as the regions, and the total page count must be @p ndesc. This is
+ * how @ref parse_bitmap creates the map.
+ */
+static int
+check_index(kdump_ctx_t *ctx, const struct dd_file *file,
+	    const struct pfn_rgn *rgn, size_t num, uint64_t ndesc)
+{
+	kdump_pfn_t max_pfn = get_max_pfn(ctx);
+	kdump_pfn_t next_pfn = 0;
+	uint64_t cnt = 0;
+	size_t i;
+
+	for (i = 0; i < num; ++i, ++rgn) {
+		if (rgn->pfn < next_pfn || !rgn->cnt ||
+		    rgn->pfn > max_pfn || rgn->cnt > max_pfn - rgn->pfn)
+			return 0;
+		if (rgn->pos != file->desc_off +
+		    (off_t)(cnt * sizeof(struct page_desc)))
+			return 0;
+		next_pfn = rgn->pfn + rgn->cnt;
+		cnt += rgn->cnt;
+	}
+	return cnt == ndesc;
+}
+
+/**  Load the PFN region map from the sidecar index.
+ * @param ctx   Dump file object.
+ * @param hash  Hash of the dump file header.
+ * @returns     Error status (@c KDUMP_ERR_NODATA if there is no
+ *              usable index).
+ *
+ * The region map is used directly from the mapped index file. It is
+ * checked with @ref check_index first, because a stale or damaged
+ * index must not direct reads to arbitrary file positions.
+ */
+static kdump_status
+load_index(kdump_ctx_t *ctx, unsigned long hash)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	struct dd_file *file = &ddp->files[0];
+	const struct pfn_rgn *rgn;
+	const uint64_t *ndesc;
+	size_t rgnlen, len;
+	off_t off;
+	kdump_status ret;
+
+	ret = kdidx_open(ctx, hash, &ddp->idx);
+	if (ret != KDUMP_OK)
+		return ret;
+
+	rgn = kdidx_section(&ddp->idx, KDIDX_DISKDUMP_RGN, &rgnlen);
+	ndesc = kdidx_section(&ddp->idx, KDIDX_DISKDUMP_NDESC, &len);
+	if (!rgn || rgnlen % sizeof *rgn || !ndesc || len != sizeof *ndesc) {
+		kdidx_close(&ddp->idx);
+		return set_error(ctx, KDUMP_ERR_NODATA,
+				 "Invalid diskdump index");
+	}
+
+	bitmap_location(ctx, file, &off, &len);
+	if (!check_index(ctx, file, rgn, rgnlen / sizeof *rgn, *ndesc)) {
+		kdidx_close(&ddp->idx);
+		return set_error(ctx, KDUMP_ERR_NODATA,
+				 "Inconsistent diskdump index");
+	}
+
+	/* The mapping is read-only, but the map is never modified. */
+	ddp->pfn_rgn = (struct pfn_rgn *) rgn;
+	ddp->pfn_rgn_num = rgnlen / sizeof *rgn;
+	file->ndesc = *ndesc;
+	return KDUMP_OK;
+}
+
+/**  Save the PFN region map to the sidecar index.
+ * @param ctx   Dump file object.
+ * @param hash  Hash of the dump file header.
+ *
+ * The index is only a cache, so errors are ignored.
+ */
+static void
+save_index(kdump_ctx_t *ctx, unsigned long hash)
+{
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	uint64_t ndesc = ddp->files[0].ndesc;
+	struct kdidx_data sects[2];
+
+	sects[0].id = KDIDX_DISKDUMP_RGN;
+	sects[0].data = ddp->pfn_rgn;
+	sects[0].len = ddp->pfn_rgn_num * sizeof(struct pfn_rgn);
+	sects[1].id = KDIDX_DISKDUMP_NDESC;
+	sects[1].data = &ndesc;
+	sects[1].len = sizeof ndesc;
+	if (kdidx_write(ctx, hash, sects, ARRAY_SIZE(sects)) != KDUMP_OK)
+		clear_error(ctx);
+}
+
 static kdump_status
 try_header(kdump_ctx_t *ctx, int32_t block_size,
 	   uint32_t bitmap_blocks, uint32_t max_mapnr)
@@ -692,6 +1295,30 @@ try_header(kdump_ctx_t *ctx, int32_t block_size,
 	return KDUMP_OK;
 }
 
+/**  Get the PFN range of a split dump file (32-bit sub-header).
+ * @param ctx             Dump file object.
+ * @param file            Dump file (updated).
+ * @param subhdr          Sub-header of @p file.
+ * @param header_version  Dump header version.
+ */
+static void
+file_range_32(kdump_ctx_t *ctx, struct dd_file *file,
+	      const struct kdump_sub_header_32 *subhdr,
+	      int32_t header_version)
+{
+	if (header_version < 2 || !dump32toh(ctx, subhdr->split))
+		return;
+
+	file->split = true;
+	if (header_version >= 6) {
+		file->start_pfn = dump64toh(ctx, subhdr->start_pfn_64);
+		file->end_pfn = dump64toh(ctx, subhdr->end_pfn_64);
+	} else {
+		file->start_pfn = dump32toh(ctx, subhdr->start_pfn);
+		file->end_pfn = dump32toh(ctx, subhdr->end_pfn);
+	}
+}
+
 static kdump_status
 read_sub_hdr_32(struct setup_data *sdp, int32_t header_version)
 {
@@ -714,6 +1341,7 @@ read_sub_hdr_32(struct setup_data *sdp, int32_t header_version)
 				 "Cannot read subheader");
 
 	set_phys_base(ctx, dump32toh(ctx, subhdr.phys_base));
+	file_range_32(ctx, sdp->file, &subhdr, header_version);
 
 	if (header_version >= 4) {
 		sdp->note_off = dump64toh(ctx, subhdr.offset_note);
@@ -742,12 +1370,15 @@ do_header_32(struct setup_data *sdp, struct disk_dump_header_32 *dh,
 	set_byte_order(ctx, byte_order);
 	set_ptr_size(ctx, 4);
 
-	ret = read_sub_hdr_32(sdp, dump32toh(ctx, dh->header_version));
+	sdp->hdr64 = false;
+	sdp->header_version = dump32toh(ctx, dh->header_version);
+	ret = read_sub_hdr_32(sdp, sdp->header_version);
 	if (ret != KDUMP_OK)
 		return ret;
 
-	return read_bitmap(ctx, dump32toh(ctx, dh->sub_hdr_size),
-			   dump32toh(ctx, dh->bitmap_blocks));
+	sdp->file->sub_hdr_size = dump32toh(ctx, dh->sub_hdr_size);
+	sdp->file->bitmap_blocks = dump32toh(ctx, dh->bitmap_blocks);
+	return KDUMP_OK;
 }
 
 static kdump_status
@@ -775,6 +1406,30 @@ try_header_32(struct setup_data *sdp, struct disk_dump_header_32 *dh)
 	return ret;
 }
 
+/**  Get the PFN range of a split dump file (64-bit sub-header).
+ * @param ctx             Dump file object.
+ * @param file            Dump file (updated).
+ * @param subhdr          Sub-header of @p file.
+ * @param header_version  Dump header version.
+ */
+static void
+file_range_64(kdump_ctx_t *ctx, struct dd_file *file,
+	      const struct kdump_sub_header_64 *subhdr,
+	      int32_t header_version)
+{
+	if (header_version < 2 || !dump32toh(ctx, subhdr->split))
+		return;
+
+	file->split = true;
+	if (header_version >= 6) {
+		file->start_pfn = dump64toh(ctx, subhdr->start_pfn_64);
+		file->end_pfn = dump64toh(ctx, subhdr->end_pfn_64);
+	} else {
+		file->start_pfn = dump64toh(ctx, subhdr->start_pfn);
+		file->end_pfn = dump64toh(ctx, subhdr->end_pfn);
+	}
+}
+
 static kdump_status
 read_sub_hdr_64(struct setup_data *sdp, int32_t header_version)
 {
@@ -797,6 +1452,7 @@ read_sub_hdr_64(struct setup_data *sdp, int32_t header_version)
 				 "Cannot read subheader");
 
 	set_phys_base(ctx, dump64toh(ctx, subhdr.phys_base));
+	file_range_64(ctx, sdp->file, &subhdr, header_version);
 
 	if (header_version >= 4) {
 		sdp->note_off = dump64toh(ctx, subhdr.offset_note);
@@ -825,12 +1481,15 @@ do_header_64(struct setup_data *sdp, struct disk_dump_header_64 *dh,
 	set_byte_order(ctx, byte_order);
 	set_ptr_size(ctx, 8);
 
-	ret = read_sub_hdr_64(sdp, dump32toh(ctx, dh->header_version));
+	sdp->hdr64 = true;
+	sdp->header_version = dump32toh(ctx, dh->header_version);
+	ret = read_sub_hdr_64(sdp, sdp->header_version);
 	if (ret != KDUMP_OK)
 		return ret;
 
-	return read_bitmap(ctx, dump32toh(ctx, dh->sub_hdr_size),
-			   dump32toh(ctx, dh->bitmap_blocks));
+	sdp->file->sub_hdr_size = dump32toh(ctx, dh->sub_hdr_size);
+	sdp->file->bitmap_blocks = dump32toh(ctx, dh->bitmap_blocks);
+	return KDUMP_OK;
 }
 
 static kdump_status
@@ -858,6 +1517,145 @@ try_header_64(struct setup_data *sdp, struct disk_dump_header_64 *dh)
 	return ret;
 }
 
+/**  Read the headers of an additional split dump file.
+ * @param sdp   Setup data (headers of the first file are already read).
+ * @param file  Split dump file; the file cache must be set.
+ * @returns     Error status.
+ *
+ * The file must be a part of the same dump as the first file, i.e.
+ * it must have the same signature, header version, block size and
+ * bitmap size.
+ */
+static kdump_status
+read_split_hdr(struct setup_data *sdp, struct dd_file *file)
+{
+	kdump_ctx_t *ctx = sdp->ctx;
+	struct disk_dump_priv *ddp = ctx->shared->fmtdata;
+	union {
+		struct disk_dump_header_32 h32;
+		struct disk_dump_header_64 h64;
+	} dh;
+	union {
+		struct kdump_sub_header_32 h32;
+		struct kdump_sub_header_64 h64;
+	} subhdr;
+	int32_t header_version, block_size;
+	kdump_status ret;
+
+	ret = fcache_pread(file->fcache, &dh, sizeof dh, 0);
+	if (ret != KDUMP_OK)
+		return set_error(ctx, ret, "Cannot read dump header");
+
+	if (memcmp(&dh, sdp->hdr, SIG_LEN))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Signature mismatch");
+
+	if (sdp->hdr64) {
+		header_version = dump32toh(ctx, dh.h64.header_version);
+		block_size = dump32toh(ctx, dh.h64.block_size);
+		file->sub_hdr_size = dump32toh(ctx, dh.h64.sub_hdr_size);
+		file->bitmap_blocks = dump32toh(ctx, dh.h64.bitmap_blocks);
+	} else {
+		header_version = dump32toh(ctx, dh.h32.header_version);
+		block_size = dump32toh(ctx, dh.h32.block_size);
+		file->sub_hdr_size = dump32toh(ctx, dh.h32.sub_hdr_size);
+		file->bitmap_blocks = dump32toh(ctx, dh.h32.bitmap_blocks);
+	}
+
+	if (header_version != sdp->header_version)
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Header version mismatch: %ld != %ld",
+				 (long) header_version,
+				 (long) sdp->header_version);
+	if (block_size != get_page_size(ctx))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Block size mismatch: %ld != %ld",
+				 (long) block_size,
+				 (long) get_page_size(ctx));
+	if (file->bitmap_blocks != ddp->files[0].bitmap_blocks)
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Bitmap size mismatch: %ld != %ld",
+				 (long) file->bitmap_blocks,
+				 (long) ddp->files[0].bitmap_blocks);
+
+	ret = fcache_pread(file->fcache, &subhdr, sizeof subhdr,
+			   get_page_size(ctx));
+	if (ret != KDUMP_OK)
+		return set_error(ctx, ret, "Cannot read subheader");
+
+	if (sdp->hdr64)
+		file_range_64(ctx, file, &subhdr.h64, header_version);
+	else
+		file_range_32(ctx, file, &subhdr.h32, header_version);
+	if (!file->split)
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Not a split dump file");
+
+	return KDUMP_OK;
+}
+
+/**  Compare two dump files by their first PFN.
+ * @param a  First file (@ref dd_file).
+ * @param b  Second file (@ref dd_file).
+ * @returns  Negative, zero or positive, like @c strcmp.
+ */
+static int
+file_cmp(const void *a, const void *b)
+{
+	const struct dd_file *fa = a, *fb = b;
+
+	if (fa->start_pfn != fb->start_pfn)
+		return fa->start_pfn < fb->start_pfn ? -1 : 1;
+	return 0;
+}
+
+/**  Open additional files of a split dump.
+ * @param sdp  Setup data (headers of the first file are already read).
+ * @returns    Error status.
+ *
+ * The file descriptors are taken from @c split_fds in the shared data.
+ * Each file gets its own file cache, so reads from different files do
+ * not compete for the same cache entries. The files are then sorted
+ * by their starting PFN, and their PFN ranges must not overlap.
+ */
+static kdump_status
+open_split_files(struct setup_data *sdp)
+{
+	kdump_ctx_t *ctx = sdp->ctx;
+	struct kdump_shared *shared = ctx->shared;
+	struct disk_dump_priv *ddp = shared->fmtdata;
+	struct dd_file *file;
+	unsigned i;
+	kdump_status ret;
+
+	if (!ddp->files[0].split)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Not a split dump file");
+
+	for (i = 1; i < ddp->nfiles; ++i) {
+		file = &ddp->files[i];
+		file->fcache = fcache_new(shared->split_fds[i - 1],
+					  FCACHE_SIZE, FCACHE_ORDER);
+		if (!file->fcache)
+			return set_error(ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot allocate file cache");
+		file->fcache->mmap_policy = shared->fcache->mmap_policy;
+
+		ret = read_split_hdr(sdp, file);
+		if (ret != KDUMP_OK)
+			return set_error(ctx, ret, "Split file #%u", i);
+	}
+	shared->nsplit_fds = 0;
+
+	qsort(ddp->files, ddp->nfiles, sizeof *ddp->files, file_cmp);
+	for (i = 1; i < ddp->nfiles; ++i)
+		if (ddp->files[i].start_pfn < ddp->files[i - 1].end_pfn)
+			return set_error(ctx, KDUMP_ERR_CORRUPT,
+					 "Overlapping split files");
+
+	return KDUMP_OK;
+}
+
 static kdump_status
 open_common(kdump_ctx_t *ctx, void *hdr)
 {
@@ -865,11 +1663,15 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 	struct disk_dump_header_64 *dh64 = hdr;
 	struct disk_dump_priv *ddp;
 	struct setup_data sd;
+	struct dd_file *file;
 	kdump_bmp_t *bmp;
+	unsigned long idxhash;
+	unsigned i;
 	kdump_status ret;
 
 	memset(&sd, 0, sizeof sd);
 	sd.ctx = ctx;
+	sd.hdr = hdr;
 
 	ddp = calloc(1, sizeof *ddp);
 	if (!ddp)
@@ -880,9 +1682,51 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 			  &ddp->page_size_override);
 	ddp->page_size_override.ops.post_set = diskdump_realloc_compressed;
 	ddp->cbuf_slot = -1;
+	ddp->zlib_slot = -1;
+	ddp->zstd_slot = -1;
+	ddp->hint_slot = -1;
 
 	ctx->shared->fmtdata = ddp;
 
+	ddp->hint_slot = per_ctx_alloc(ctx->shared, sizeof(size_t), NULL);
+	if (ddp->hint_slot < 0) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate PFN region hint slot");
+		goto err_cleanup;
+	}
+
+	ddp->nfiles = 1 + ctx->shared->nsplit_fds;
+	ddp->files = calloc(ddp->nfiles, sizeof *ddp->files);
+	if (!ddp->files) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate dump file array");
+		goto err_cleanup;
+	}
+	for (i = 0; i < ddp->nfiles; ++i)
+		ddp->files[i].end_pfn = ~(kdump_pfn_t)0;
+	ddp->files[0].fcache = ctx->shared->fcache;
+	fcache_incref(ctx->shared->fcache);
+	sd.file = &ddp->files[0];
+
+#if USE_ZLIB || USE_LIBDEFLATE
+	ddp->zlib_slot = gzip_slot_alloc(ctx->shared);
+	if (ddp->zlib_slot < 0) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate zlib state slot");
+		goto err_cleanup;
+	}
+#endif
+
+#if USE_ZSTD
+	ddp->zstd_slot = per_ctx_alloc(ctx->shared, sizeof(ZSTD_DCtx *),
+				       free_zstd_dctx);
+	if (ddp->zstd_slot < 0) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate zstd context slot");
+		goto err_cleanup;
+	}
+#endif
+
 	set_addrspace_caps(ctx->xlat, ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR));
 
 	ret = try_header_32(&sd, dh32);
@@ -898,6 +1742,44 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 	if (ret != KDUMP_OK)
 		goto err_cleanup;
 
+	if (ddp->nfiles > 1) {
+		ret = open_split_files(&sd);
+		if (ret != KDUMP_OK)
+			goto err_cleanup;
+	}
+
+	for (i = 0; i < ddp->nfiles; ++i) {
+		file = &ddp->files[i];
+		file->pdcache = cache_alloc(PD_CACHE_BLOCKS, PD_BLOCK_DESCS *
+					    sizeof(struct page_desc));
+		if (!file->pdcache) {
+			ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+					"Cannot allocate page descriptor cache");
+			goto err_cleanup;
+		}
+	}
+
+	/* The sidecar index is used only for single-file dumps. */
+	idxhash = mem_hash(hdr, sizeof(struct disk_dump_header_64));
+	ret = (ddp->nfiles == 1)
+		? load_index(ctx, idxhash)
+		: KDUMP_ERR_NODATA;
+	if (ret == KDUMP_ERR_NODATA) {
+		clear_error(ctx);
+		for (i = 0; i < ddp->nfiles; ++i) {
+			ret = read_bitmap(ctx, &ddp->files[i]);
+			if (ret != KDUMP_OK)
+				goto err_cleanup;
+		}
+		if (ddp->nfiles == 1)
+			save_index(ctx, idxhash);
+	} else if (ret != KDUMP_OK)
+		goto err_cleanup;
+
+	ret = build_rgn_index(ctx);
+	if (ret != KDUMP_OK)
+		goto err_cleanup;
+
 	bmp = kdump_bmp_new(&diskdump_bmp_ops);
 	if (!bmp) {
 		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
@@ -965,12 +1847,31 @@ static void
 diskdump_cleanup(struct kdump_shared *shared)
 {
 	struct disk_dump_priv *ddp = shared->fmtdata;
+	unsigned i;
 
 	if (ddp) {
-		if (ddp->pfn_rgn)
+		if (ddp->idx.map)
+			kdidx_close(&ddp->idx);
+		else if (ddp->pfn_rgn)
 			free(ddp->pfn_rgn);
+		if (ddp->rgn_index)
+			free(ddp->rgn_index);
+		if (ddp->hint_slot >= 0)
+			per_ctx_free(shared, ddp->hint_slot);
+		for (i = 0; ddp->files && i < ddp->nfiles; ++i) {
+			if (ddp->files[i].pdcache)
+				cache_free(ddp->files[i].pdcache);
+			if (ddp->files[i].fcache)
+				fcache_decref(ddp->files[i].fcache);
+		}
+		if (ddp->files)
+			free(ddp->files);
 		if (ddp->cbuf_slot >= 0)
 			per_ctx_free(shared, ddp->cbuf_slot);
+		if (ddp->zlib_slot >= 0)
+			per_ctx_free(shared, ddp->zlib_slot);
+		if (ddp->zstd_slot >= 0)
+			per_ctx_free(shared, ddp->zstd_slot);
 		free(ddp);
 		shared->fmtdata = NULL;
 	}
@@ -105,17 +105,29 @@ struct pfn2idx_map {
  */
 #define PFN2IDX_ALLOC_INC    16
 
+/** Per-context LOAD segment lookup hint.
+ */
+struct load_hint {
+	size_t load;		/**< Index of the last hit in load_sorted. */
+	size_t vload;		/**< Index of the last hit in load_vsorted. */
+};
+
 struct elfdump_priv {
 	int num_load_segments;
 	struct load_segment *load_segments;
 
 	int num_load_sorted;
 	struct load_segment *load_sorted;
-	struct load_segment *last_load;
+	/** Highest end of @c load_sorted[0] to @c load_sorted[i]. */
+	kdump_addr_t *load_maxend;
 
 	int num_load_vsorted;
 	struct load_segment *load_vsorted;
-	struct load_segment  *last_vload;
+	/** Highest end of @c load_vsorted[0] to @c load_vsorted[i]. */
+	kdump_addr_t *load_vmaxend;
+
+	/** Per-context slot for @ref load_hint. */
+	int hint_slot;
 
 	int num_note_segments;
 	struct load_segment *note_segments;
@@ -165,64 +177,119 @@ mach2arch(unsigned mach, int elfclass)
 	}
 }
 
+/**  Find the first LOAD segment which ends above an address.
+ * @param maxend  Highest segment end up to each index.
+ * @param num     Number of elements in @p maxend.
+ * @param addr    Requested address.
+ * @returns       Index of the segment, or @p num if none.
+ *
+ * Segments may overlap, so their ends need not be sorted, but the
+ * running maximum of the ends is. The first index where the maximum
+ * exceeds @p addr is also the first segment which ends above @p addr.
+ */
+static size_t
+first_load_above(const kdump_addr_t *maxend, size_t num, kdump_addr_t addr)
+{
+	size_t lo = 0, hi = num;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (maxend[mid] > addr)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
 /**  Find the LOAD segment that is closest to a physical address.
  * @param edp	 ELF dump private data.
+ * @param hint	 Per-context lookup hint, or @c NULL.
  * @param paddr	 Requested physical address.
  * @param dist	 Maximum allowed distance from @c paddr.
  * @returns	 Pointer to the closest LOAD segment, or @c NULL if none.
  */
 static struct load_segment *
-find_closest_load(struct elfdump_priv *edp, kdump_paddr_t paddr,
-		  unsigned long dist)
+find_closest_load(struct elfdump_priv *edp, struct load_hint *hint,
+		  kdump_paddr_t paddr, unsigned long dist)
 {
-	int i;
-
-	if (edp->last_load &&
-	    paddr >= edp->last_load->phys &&
-	    paddr < edp->last_load->phys + edp->last_load->memsz)
-		return edp->last_load;
+	struct load_segment *pls;
+	size_t i;
 
-	for (i = 0; i < edp->num_load_sorted; i++) {
-		struct load_segment *pls = &edp->load_sorted[i];
-		if (paddr >= pls->phys + pls->memsz)
-			continue;
-		if (paddr >= pls->phys || pls->phys - paddr < dist)
-			return edp->last_load = pls;
+	if (hint && hint->load < edp->num_load_sorted) {
+		pls = &edp->load_sorted[hint->load];
+		if (paddr >= pls->phys && paddr < pls->phys + pls->memsz)
+			return pls;
 	}
-	return NULL;
+
+	i = first_load_above(edp->load_maxend, edp->num_load_sorted, paddr);
+	if (i >= edp->num_load_sorted)
+		return NULL;
+	pls = &edp->load_sorted[i];
+	if (paddr < pls->phys && pls->phys - paddr >= dist)
+		return NULL;
+	if (hint)
+		hint->load = i;
+	return pls;
 }
 
 /**  Find the LOAD segment that is closest to a virtual address.
  * @param edp	 ELF dump private data.
+ * @param hint	 Per-context lookup hint, or @c NULL.
  * @param vaddr	 Requested virtual address.
  * @param dist	 Maximum allowed distance from @c vaddr.
  * @returns	 Pointer to the closest LOAD segment, or @c NULL if none.
  */
 static struct load_segment *
-find_closest_vload(struct elfdump_priv *edp, kdump_vaddr_t vaddr,
-		   unsigned long dist)
+find_closest_vload(struct elfdump_priv *edp, struct load_hint *hint,
+		   kdump_vaddr_t vaddr, unsigned long dist)
 {
-	int i;
+	struct load_segment *pls;
+	size_t i;
+
+	if (hint && hint->vload < edp->num_load_vsorted) {
+		pls = &edp->load_vsorted[hint->vload];
+		if (vaddr >= pls->virt && vaddr < pls->virt + pls->memsz)
+			return pls;
+	}
 
-	if (edp->last_vload &&
-	    vaddr >= edp->last_vload->virt &&
-	    vaddr < edp->last_vload->virt + edp->last_vload->memsz)
-		return edp->last_vload;
+	i = first_load_above(edp->load_vmaxend, edp->num_load_vsorted, vaddr);
+	if (i >= edp->num_load_vsorted)
+		return NULL;
+	pls = &edp->load_vsorted[i];
+	if (vaddr < pls->virt && pls->virt - vaddr >= dist)
+		return NULL;
+	if (hint)
+		hint->vload = i;
+	return pls;
+}
 
-	for (i = 0; i < edp->num_load_vsorted; i++) {
-		struct load_segment *pls = &edp->load_vsorted[i];
-		if (vaddr >= pls->virt + pls->memsz)
-			continue;
-		if (vaddr >= pls->virt || pls->virt - vaddr < dist)
-			return edp->last_load = pls;
+/**  Compute the running maximum of LOAD segment ends.
+ * @param segs    Sorted LOAD segments.
+ * @param num     Number of elements in @p segs.
+ * @param maxend  Highest end up to each index (filled in).
+ * @param virt    Use virtual addresses if non-zero.
+ */
+static void
+init_load_maxend(const struct load_segment *segs, size_t num,
+		 kdump_addr_t *maxend, int virt)
+{
+	kdump_addr_t end, max = 0;
+	size_t i;
+
+	for (i = 0; i < num; ++i) {
+		end = (virt ? segs[i].virt : segs[i].phys) + segs[i].memsz;
+		if (end > max)
+			max = end;
+		maxend[i] = max;
 	}
-	return NULL;
 }
 
 static kdump_status
 elf_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 {
 	struct elfdump_priv *edp = ctx->shared->fmtdata;
+	struct load_hint *hint = ctx->data[edp->hint_slot];
 	kdump_addr_t addr;
 	struct load_segment *pls;
 	kdump_addr_t loadaddr;
@@ -231,15 +298,13 @@ elf_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 	size_t size;
 	kdump_status status;
 
-	mutex_lock(&ctx->shared->cache_lock);
-
 	addr = pio->addr.addr;
 	p = pio->chunk.data;
 	endp = p + get_page_size(ctx);
 	while (p < endp) {
 		pls = (pio->addr.as == ADDRXLAT_KVADDR
-		       ? find_closest_vload(edp, addr, endp - p)
-		       : find_closest_load(edp, addr, endp - p));
+		       ? find_closest_vload(edp, hint, addr, endp - p)
+		       : find_closest_load(edp, hint, addr, endp - p));
 		if (!pls) {
 			memset(p, 0, endp - p);
 			break;
@@ -277,11 +342,9 @@ elf_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 		}
 	}
 
-	mutex_unlock(&ctx->shared->cache_lock);
 	return KDUMP_OK;
 
  err_read:
-	mutex_unlock(&ctx->shared->cache_lock);
 	return set_error(ctx, status,
 			 "Cannot read page data at %llu",
 			 (unsigned long long) pos);
@@ -291,15 +354,15 @@ static kdump_status
 elf_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 {
 	struct elfdump_priv *edp = ctx->shared->fmtdata;
+	struct load_hint *hint = ctx->data[edp->hint_slot];
 	struct load_segment *pls;
 	kdump_paddr_t addr, loadaddr;
 	size_t sz;
-	kdump_status status;
 
 	sz = get_page_size(ctx);
 	pls = (pio->addr.as == ADDRXLAT_KVADDR
-	       ? find_closest_vload(edp, pio->addr.addr, sz)
-	       : find_closest_load(edp, pio->addr.addr, sz));
+	       ? find_closest_vload(edp, hint, pio->addr.addr, sz)
+	       : find_closest_load(edp, hint, pio->addr.addr, sz));
 	if (!pls) {
 		addrxlat_status status;
 		kdump_status ret;
@@ -318,7 +381,7 @@ elf_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 		if (status != ADDRXLAT_OK)
 			return addrxlat2kdump(ctx, status);
 
-		pls = find_closest_load(edp, pio->addr.addr, sz);
+		pls = find_closest_load(edp, hint, pio->addr.addr, sz);
 		if (!pls)
 			return set_error(ctx, KDUMP_ERR_NODATA,
 					 "Page not found");
@@ -329,15 +392,17 @@ elf_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 		    ? pls->virt
 		    : pls->phys);
 
+	/* Pages between filesz and memsz read as zeroes. */
+	if (loadaddr <= addr && addr - loadaddr >= pls->filesz &&
+	    pls->memsz >= addr - loadaddr + sz)
+		return get_zero_page(ctx, pio);
+
 	/* Handle reads crossing a LOAD boundary. */
 	if (! (loadaddr <= addr && pls->filesz >= addr - loadaddr + sz))
 		return cache_get_page(ctx, pio, elf_read_page);
 
-	mutex_lock(&ctx->shared->cache_lock);
-	status = fcache_get_chunk(ctx->shared->fcache, &pio->chunk, sz,
-				  pls->file_offset + addr - loadaddr);
-	mutex_unlock(&ctx->shared->cache_lock);
-	return status;
+	return fcache_get_chunk(ctx->shared->fcache, &pio->chunk, sz,
+				pls->file_offset + addr - loadaddr);
 }
 
 static kdump_status
@@ -352,7 +417,7 @@ elf_get_bits(kdump_errmsg_t *err, const kdump_bmp_t *bmp,
 	rwlock_rdlock(&shared->lock);
 	edp = shared->fmtdata;
 
-	pls = find_closest_load(edp, pfn_to_addr(shared, first),
+	pls = find_closest_load(edp, NULL, pfn_to_addr(shared, first),
 				pfn_to_addr(shared, last - first + 1));
 	if (!pls) {
 		memset(bits, 0, ((last - first) >> 3) + 1);
@@ -399,7 +464,7 @@ elf_find_set(kdump_errmsg_t *err, const kdump_bmp_t *bmp,
 
 	rwlock_rdlock(&shared->lock);
 	edp = shared->fmtdata;
-	pls = find_closest_load(edp, pfn_to_addr(shared, *idx),
+	pls = find_closest_load(edp, NULL, pfn_to_addr(shared, *idx),
 				KDUMP_ADDR_MAX);
 	if (!pls) {
 		rwlock_unlock(&shared->lock);
@@ -423,7 +488,7 @@ elf_find_clear(kdump_errmsg_t *err, const kdump_bmp_t *bmp,
 
 	rwlock_rdlock(&shared->lock);
 	edp = shared->fmtdata;
-	pls = find_closest_load(edp, pfn_to_addr(shared, *idx),
+	pls = find_closest_load(edp, NULL, pfn_to_addr(shared, *idx),
 				KDUMP_ADDR_MAX);
 	if (pls)
 		while (pls < &edp->load_sorted[edp->num_load_sorted] &&
@@ -744,9 +809,7 @@ xc_p2m_first_step(addrxlat_step_t *step, addrxlat_addr_t addr)
 					"PFN not found");
 
 	pos = edp->xen_map_offset + idx * sizeof(struct xen_p2m);
-	mutex_lock(&shared->cache_lock);
 	status = fcache_pread(shared->fcache, &p2m, sizeof p2m, pos);
-	mutex_unlock(&shared->cache_lock);
 	if (status != KDUMP_OK)
 		return addrxlat_ctx_err(step->ctx, ADDRXLAT_ERR_NODATA,
 					"Cannot read p2m entry at %llu",
@@ -782,9 +845,7 @@ xc_m2p_first_step(addrxlat_step_t *step, addrxlat_addr_t addr)
 					"MFN not found");
 
 	pos = edp->xen_map_offset + idx * sizeof(struct xen_p2m);
-	mutex_lock(&shared->cache_lock);
 	status = fcache_pread(shared->fcache, &p2m, sizeof p2m, pos);
-	mutex_unlock(&shared->cache_lock);
 	if (status != KDUMP_OK)
 		return addrxlat_ctx_err(step->ctx, ADDRXLAT_ERR_NODATA,
 					"Cannot read p2m entry at %llu",
@@ -875,7 +936,6 @@ xc_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 	kdump_pfn_t pfn = pio->addr.addr >> get_page_shift(ctx);
 	uint_fast64_t idx;
 	off_t offset;
-	kdump_status status;
 
 	idx = ( (get_xen_xlat(ctx) == KDUMP_XEN_NONAUTO &&
 		 pio->addr.as == ADDRXLAT_MACHPHYSADDR)
@@ -886,11 +946,8 @@ xc_get_page(kdump_ctx_t *ctx, struct page_io *pio)
 
 	offset = edp->xen_pages_offset + ((off_t)idx << get_page_shift(ctx));
 
-	mutex_lock(&ctx->shared->cache_lock);
-	status = fcache_get_chunk(ctx->shared->fcache, &pio->chunk,
-				  get_page_size(ctx), offset);
-	mutex_unlock(&ctx->shared->cache_lock);
-	return status;
+	return fcache_get_chunk(ctx->shared->fcache, &pio->chunk,
+				get_page_size(ctx), offset);
 }
 
 static kdump_status
@@ -1253,7 +1310,7 @@ static int
 seg_virt_cmp(const void *a, const void *b)
 {
 	const struct load_segment *la = a, *lb = b;
-	return la->phys != lb->phys ? (la->phys < lb->phys ? -1 : 1) : 0;
+	return la->virt != lb->virt ? (la->virt < lb->virt ? -1 : 1) : 0;
 }
 
 static kdump_status
@@ -1277,6 +1334,19 @@ open_common(kdump_ctx_t *ctx)
 		return KDUMP_ERR_SYSTEM;
 	edp->load_vsorted = edp->load_sorted + edp->num_load_segments;
 
+	edp->load_maxend = ctx_malloc(2 * edp->num_load_segments *
+				      sizeof(*edp->load_maxend),
+				      ctx, "LOAD segment ends");
+	if (!edp->load_maxend)
+		return KDUMP_ERR_SYSTEM;
+	edp->load_vmaxend = edp->load_maxend + edp->num_load_segments;
+
+	edp->hint_slot = per_ctx_alloc(ctx->shared, sizeof(struct load_hint),
+				       NULL);
+	if (edp->hint_slot < 0)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate LOAD segment hint slot");
+
 	bmp = kdump_bmp_new(&elf_bmp_ops);
 	if (!bmp)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
@@ -1345,6 +1415,11 @@ open_common(kdump_ctx_t *ctx)
 	qsort(edp->load_vsorted, edp->num_load_segments,
 	      sizeof(struct load_segment), seg_virt_cmp);
 
+	init_load_maxend(edp->load_sorted, edp->num_load_sorted,
+			 edp->load_maxend, 0);
+	init_load_maxend(edp->load_vsorted, edp->num_load_vsorted,
+			 edp->load_vmaxend, 1);
+
 	free(edp->load_segments);
 	edp->load_segments = edp->note_segments = NULL;
 
@@ -1426,6 +1501,7 @@ do_probe(kdump_ctx_t *ctx, void *hdr)
 	if (!edp)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate ELF dump private data");
+	edp->hint_slot = -1;
 	ctx->shared->fmtdata = edp;
 
 	switch (eheader[EI_DATA]) {
@@ -1490,6 +1566,10 @@ elf_cleanup(struct kdump_shared *shared)
 	if (edp) {
 		if (edp->load_sorted)
 			free(edp->load_sorted);
+		if (edp->load_maxend)
+			free(edp->load_maxend);
+		if (edp->hint_slot >= 0)
+			per_ctx_free(shared, edp->hint_slot);
 		if (edp->load_segments)
 			free(edp->load_segments);
 		if (edp->sections)
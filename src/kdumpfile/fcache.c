@@ -81,6 +81,8 @@ fcache_new(int fd, unsigned n, unsigned order)
 	if (!fc->fbcache)
 		goto err_cache;
 
+	fc->ext = NULL;
+	fc->next = 0;
 	fc->filesz = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
 		      ? st.st_size
 		      : ((unsigned long long) ~(off_t)0) >> 1);
@@ -102,14 +104,116 @@ fcache_free(struct fcache *fc)
 {
 	cache_free(fc->fbcache);
 	cache_free(fc->cache);
+	if (fc->ext)
+		free(fc->ext);
 	free(fc);
 }
 
+/** Set the logical file extent map of a file cache.
+ * @param fc    File cache object.
+ * @param ext   Extents sorted by logical position (not overlapping).
+ * @param next  Number of elements in @p ext.
+ *
+ * The file cache takes ownership of @p ext. All cached content is
+ * discarded, and the file size is set to the end of the last extent.
+ */
+void
+fcache_set_extents(struct fcache *fc, struct fcache_extent *ext,
+		   size_t next)
+{
+	cache_flush(fc->cache);
+	cache_flush(fc->fbcache);
+	if (fc->ext)
+		free(fc->ext);
+	fc->ext = ext;
+	fc->next = next;
+	fc->filesz = next
+		? ext[next - 1].pos + ext[next - 1].len
+		: 0;
+}
+
+/** Read data from a logical file.
+ * @param fc   File cache object (with an extent map).
+ * @param buf  Target buffer.
+ * @param len  Length of data.
+ * @param pos  Logical file position.
+ * @returns    Number of bytes read, or -1 on error.
+ *
+ * Data which is not covered by any extent is filled with zeroes.
+ */
+static ssize_t
+pread_extents(struct fcache *fc, void *buf, size_t len, off_t pos)
+{
+	const struct fcache_extent *ext;
+	size_t left, right, mid;
+	off_t end = pos + len;
+	off_t cur = pos;
+
+	/* Find the first extent which ends above pos. */
+	left = 0;
+	right = fc->next;
+	while (left != right) {
+		mid = (left + right) / 2;
+		ext = &fc->ext[mid];
+		if (ext->pos + ext->len <= pos)
+			left = mid + 1;
+		else
+			right = mid;
+	}
+
+	for (ext = &fc->ext[left];
+	     ext < fc->ext + fc->next && ext->pos < end; ++ext) {
+		off_t first = ext->pos > cur ? ext->pos : cur;
+		off_t last = ext->pos + ext->len < end
+			? ext->pos + ext->len
+			: end;
+		ssize_t rd;
+
+		memset(buf + (cur - pos), 0, first - cur);
+		rd = pread(fc->fd, buf + (first - pos), last - first,
+			   ext->phys + (first - ext->pos));
+		if (rd < 0)
+			return rd;
+		cur = first + rd;
+		if (cur < last)
+			return cur - pos;
+	}
+	if (cur < end && cur < fc->filesz) {
+		off_t last = end < fc->filesz ? end : fc->filesz;
+		memset(buf + (cur - pos), 0, last - cur);
+		cur = last;
+	}
+
+	return cur - pos;
+}
+
+/** Read data without caching.
+ * @param fc   File cache object.
+ * @param buf  Target buffer.
+ * @param len  Length of data.
+ * @param pos  File position.
+ * @returns    Number of bytes read, or -1 on error (see @c errno).
+ *
+ * This function is meant for large sequential scans, which would
+ * only evict useful data from the cache. It is safe to call it
+ * from any thread.
+ */
+ssize_t
+fcache_read_direct(struct fcache *fc, void *buf, size_t len, off_t pos)
+{
+	return fc->ext
+		? pread_extents(fc, buf, len, pos)
+		: pread(fc->fd, buf, len, pos);
+}
+
 /** Get file cache content using mmap(2).
  * @param fc   File cache object.
  * @param fce  File cache entry, updated on success.
  * @param pos  File position.
  * @returns    Error status.
+ *
+ * The cache lock is held only while looking up and inserting the
+ * cache entry. The mmap(2) call itself is done without any lock.
  */
 kdump_status
 fcache_get_mmap(struct fcache *fc, struct fcache_entry *fce, off_t pos)
@@ -128,9 +232,11 @@ fcache_get_mmap(struct fcache *fc, struct fcache_entry *fce, off_t pos)
 		return KDUMP_ERR_BUSY;
 
 	if (!cache_entry_valid(ce)) {
-		ce->data = mmap(NULL, fc->mmapsz, PROT_READ,
-				MAP_SHARED, fc->fd, blkpos);
-		cache_insert(fc->cache, ce);
+		void *data = mmap(NULL, fc->mmapsz, PROT_READ,
+				  MAP_SHARED, fc->fd, blkpos);
+		if (!cache_insert_data(fc->cache, ce, data) &&
+		    data != MAP_FAILED)
+			munmap(data, fc->mmapsz);
 	}
 
 	if (ce->data == MAP_FAILED)
@@ -149,6 +255,10 @@ fcache_get_mmap(struct fcache *fc, struct fcache_entry *fce, off_t pos)
  * @param fce  File cache entry, updated on success.
  * @param pos  File position.
  * @returns    Error status.
+ *
+ * The cache lock is held only while looking up and inserting the
+ * cache entry. The data is read into the (referenced) in-flight entry
+ * without any lock.
  */
 kdump_status
 fcache_get_read(struct fcache *fc, struct fcache_entry *fce, off_t pos)
@@ -163,7 +273,9 @@ fcache_get_read(struct fcache *fc, struct fcache_entry *fce, off_t pos)
 		return KDUMP_ERR_BUSY;
 
 	if (!cache_entry_valid(ce)) {
-		ssize_t rd = pread(fc->fd, ce->data, fc->pgsz, blkpos);
+		ssize_t rd = fc->ext
+			? pread_extents(fc, ce->data, fc->pgsz, blkpos)
+			: pread(fc->fd, ce->data, fc->pgsz, blkpos);
 		if (rd < 0) {
 			cache_discard(fc->fbcache, ce);
 			return KDUMP_ERR_SYSTEM;
@@ -193,7 +305,7 @@ fcache_get(struct fcache *fc, struct fcache_entry *fce, off_t pos)
 	kdump_mmap_policy_t policy = fc->mmap_policy.number;
 	kdump_status status;
 
-	if (policy != KDUMP_MMAP_NEVER) {
+	if (policy != KDUMP_MMAP_NEVER && !fc->ext) {
 		status = fcache_get_mmap(fc, fce, pos);
 
 		if (policy == KDUMP_MMAP_TRY_ONCE)
@@ -0,0 +1,311 @@
+/** @internal @file src/kdumpfile/flattened.c
+ * @brief Routines to read makedumpfile flattened files.
+ */
+/* Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "kdumpfile-priv.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+/** @cond TARGET_ABI */
+
+#define MDF_SIGNATURE		"makedumpfile"
+#define MDF_SIG_LEN		16
+#define MDF_TYPE_FLAT_HEADER	1
+#define MDF_VERSION_FLAT_HEADER	1
+#define MDF_HEADER_SIZE		4096
+
+/* Flattened file header (big-endian) */
+struct makedumpfile_header {
+	char	signature[MDF_SIG_LEN];	/* = "makedumpfile" */
+	int64_t	type;
+	int64_t	version;
+} __attribute__((packed));
+
+/* Header of each data record (big-endian) */
+struct makedumpfile_data_header {
+	int64_t	offset;
+	int64_t	buf_size;
+} __attribute__((packed));
+
+/* Marker of the last record */
+#define MDF_END_FLAG		(-1)
+
+/** @endcond */
+
+/** Size of the buffer used to scan data record headers. */
+#define FLAT_BUFSZ		(1UL << 20)
+
+/** Extent map allocation increment. */
+#define EXT_ALLOC_INC		1024
+
+/** Flattened file scanning state. */
+struct flat_scan {
+	kdump_ctx_t *ctx;	/**< Dump file object. */
+	int fd;			/**< File descriptor. */
+
+	unsigned char *buf;	/**< Read buffer. */
+	off_t bufpos;		/**< File position of @c buf. */
+	size_t buflen;		/**< Number of valid bytes in @c buf. */
+
+	struct fcache_extent *ext; /**< Extent map. */
+	size_t next;		/**< Number of used elements in @c ext. */
+	size_t allocext;	/**< Number of allocated elements in @c ext. */
+};
+
+/**  Read a data record header.
+ * @param scan  Scanning state.
+ * @param pos   File position of the header.
+ * @param hdr   Record header, filled on success.
+ * @returns     @c KDUMP_OK, @c KDUMP_ERR_EOF if there is no header at
+ *              @p pos, or another error status.
+ *
+ * Record headers are read through a large buffer, so that small
+ * records do not need a system call each.
+ */
+static kdump_status
+read_data_header(struct flat_scan *scan, off_t pos,
+		 struct makedumpfile_data_header *hdr)
+{
+	ssize_t rd;
+
+	if (pos < scan->bufpos ||
+	    pos + sizeof *hdr > scan->bufpos + scan->buflen) {
+		rd = pread(scan->fd, scan->buf, FLAT_BUFSZ, pos);
+		if (rd < 0)
+			return set_error(scan->ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot read flattened data"
+					 " at %llu: %s",
+					 (unsigned long long) pos,
+					 strerror(errno));
+		scan->bufpos = pos;
+		scan->buflen = rd;
+		if (rd < sizeof *hdr)
+			return KDUMP_ERR_EOF;
+	}
+
+	memcpy(hdr, scan->buf + (pos - scan->bufpos), sizeof *hdr);
+	return KDUMP_OK;
+}
+
+/**  Make room for new elements in the extent map.
+ * @param scan  Scanning state.
+ * @param num   Number of additional elements.
+ * @returns     Error status.
+ */
+static kdump_status
+grow_extents(struct flat_scan *scan, size_t num)
+{
+	struct fcache_extent *ext;
+	size_t alloc;
+
+	if (scan->next + num <= scan->allocext)
+		return KDUMP_OK;
+
+	alloc = scan->allocext ? 2 * scan->allocext : EXT_ALLOC_INC;
+	ext = realloc(scan->ext, alloc * sizeof *ext);
+	if (!ext)
+		return set_error(scan->ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate %zu flattened extents",
+				 alloc);
+	scan->ext = ext;
+	scan->allocext = alloc;
+	return KDUMP_OK;
+}
+
+/**  Add a data record to the extent map.
+ * @param scan  Scanning state.
+ * @param pos   Logical file position of the data.
+ * @param phys  File position of the data.
+ * @param len   Length of the data.
+ * @returns     Error status.
+ *
+ * Records are usually written in ascending order, so they can be
+ * appended to the map. A record which overlaps existing extents
+ * replaces their overlapping parts, because later records overwrite
+ * earlier data in the logical file.
+ */
+static kdump_status
+add_extent(struct flat_scan *scan, off_t pos, off_t phys, off_t len)
+{
+	struct fcache_extent *ext, head, tail;
+	off_t end = pos + len;
+	size_t first, last, num;
+	kdump_status ret;
+
+	ret = grow_extents(scan, 3);
+	if (ret != KDUMP_OK)
+		return ret;
+
+	ext = scan->ext;
+	if (!scan->next ||
+	    ext[scan->next - 1].pos + ext[scan->next - 1].len <= pos) {
+		ext += scan->next++;
+		ext->pos = pos;
+		ext->phys = phys;
+		ext->len = len;
+		return KDUMP_OK;
+	}
+
+	/* Find overlapping extents [first, last). */
+	for (first = scan->next; first > 0; --first)
+		if (ext[first - 1].pos + ext[first - 1].len <= pos)
+			break;
+	for (last = first; last < scan->next; ++last)
+		if (ext[last].pos >= end)
+			break;
+
+	num = 1;
+	if (first < last && ext[first].pos < pos) {
+		head = ext[first];
+		head.len = pos - head.pos;
+		++num;
+	} else
+		head.len = 0;
+	if (first < last &&
+	    ext[last - 1].pos + ext[last - 1].len > end) {
+		tail = ext[last - 1];
+		tail.len -= end - tail.pos;
+		tail.phys += end - tail.pos;
+		tail.pos = end;
+		++num;
+	} else
+		tail.len = 0;
+
+	memmove(ext + first + num, ext + last,
+		(scan->next - last) * sizeof *ext);
+	scan->next += first + num - last;
+
+	if (head.len)
+		ext[first++] = head;
+	ext[first].pos = pos;
+	ext[first].phys = phys;
+	ext[first].len = len;
+	if (tail.len)
+		ext[first + 1] = tail;
+
+	return KDUMP_OK;
+}
+
+/**  Scan all data records of a flattened file.
+ * @param scan  Scanning state.
+ * @returns     Error status.
+ */
+static kdump_status
+scan_records(struct flat_scan *scan)
+{
+	struct makedumpfile_data_header hdr;
+	off_t pos = MDF_HEADER_SIZE;
+	int64_t offset, size;
+	kdump_status ret;
+
+	for (;;) {
+		ret = read_data_header(scan, pos, &hdr);
+		if (ret == KDUMP_ERR_EOF)
+			/* Truncated file; use what we have. */
+			return KDUMP_OK;
+		if (ret != KDUMP_OK)
+			return ret;
+
+		offset = be64toh(hdr.offset);
+		size = be64toh(hdr.buf_size);
+		if (offset == MDF_END_FLAG)
+			return KDUMP_OK;
+		if (offset < 0 || size < 0)
+			return set_error(scan->ctx, KDUMP_ERR_CORRUPT,
+					 "Invalid flattened record at %llu",
+					 (unsigned long long) pos);
+
+		pos += sizeof hdr;
+		if (size) {
+			ret = add_extent(scan, offset, pos, size);
+			if (ret != KDUMP_OK)
+				return ret;
+		}
+		pos += size;
+	}
+}
+
+/**  Open a makedumpfile flattened file.
+ * @param ctx  Dump file object.
+ * @returns    Error status, or @c KDUMP_NOPROBE if the file is not
+ *             in the flattened format.
+ *
+ * The flattened format is a stream of data records, each of which
+ * specifies its offset in the logical dump file. All records are
+ * scanned once to build a map of logical extents, and the file cache
+ * reads the logical file through this map. The dump format itself
+ * must be probed after this function succeeds.
+ */
+kdump_status
+flattened_open(kdump_ctx_t *ctx)
+{
+	struct fcache *fc = ctx->shared->fcache;
+	struct makedumpfile_header hdr;
+	struct flat_scan scan;
+	kdump_status ret;
+	ssize_t rd;
+
+	rd = pread(fc->fd, &hdr, sizeof hdr, 0);
+	if (rd != sizeof hdr ||
+	    memcmp(hdr.signature, MDF_SIGNATURE, sizeof MDF_SIGNATURE))
+		return KDUMP_NOPROBE;
+
+	if (be64toh(hdr.type) != MDF_TYPE_FLAT_HEADER)
+		return set_error(ctx, KDUMP_ERR_NOTIMPL,
+				 "Unsupported makedumpfile file type: %lld",
+				 (long long) be64toh(hdr.type));
+	if (be64toh(hdr.version) != MDF_VERSION_FLAT_HEADER)
+		return set_error(ctx, KDUMP_ERR_NOTIMPL,
+				 "Unsupported flattened format version: %lld",
+				 (long long) be64toh(hdr.version));
+
+	memset(&scan, 0, sizeof scan);
+	scan.ctx = ctx;
+	scan.fd = fc->fd;
+	scan.buf = malloc(FLAT_BUFSZ);
+	if (!scan.buf)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate flattened scan buffer");
+
+	ret = scan_records(&scan);
+	free(scan.buf);
+	if (ret != KDUMP_OK) {
+		if (scan.ext)
+			free(scan.ext);
+		return ret;
+	}
+
+	fcache_set_extents(fc, scan.ext, scan.next);
+	return KDUMP_OK;
+}
@@ -0,0 +1,345 @@
+/** @internal @file src/kdumpfile/index.c
+ * @brief Persistent sidecar index files.
+ */
+/* Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define _GNU_SOURCE
+
+#include "kdumpfile-priv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+/** Index file signature. */
+#define KDIDX_MAGIC	"KDIDX\r\n\032"
+
+/** Index file format version. */
+#define KDIDX_VERSION	1
+
+/** Byte order mark.
+ * Index files are stored in host byte order, so an index written
+ * on a host with the other byte order is rejected.
+ */
+#define KDIDX_BOM	0x01020304
+
+/** Alignment of index sections. */
+#define KDIDX_ALIGN	8
+
+/** Index section descriptor. */
+struct kdidx_sect {
+	uint32_t id;		/**< Section identifier. */
+	uint32_t pad;		/**< Padding (zero). */
+	uint64_t off;		/**< Offset from the start of the file. */
+	uint64_t len;		/**< Length of the section. */
+};
+
+/** Index file header. */
+struct kdidx_header {
+	char magic[8];		/**< Signature (@ref KDIDX_MAGIC). */
+	uint32_t version;	/**< Format version (@ref KDIDX_VERSION). */
+	uint32_t bom;		/**< Byte order mark (@ref KDIDX_BOM). */
+	uint32_t off_size;	/**< Size of @c off_t when written. */
+	uint32_t nsect;		/**< Number of sections. */
+	uint64_t file_size;	/**< Size of the dump file. */
+	int64_t mtime_sec;	/**< Dump modification time (seconds). */
+	int64_t mtime_nsec;	/**< Dump modification time (nanoseconds). */
+	uint64_t hash;		/**< Hash of format-specific header data. */
+	struct kdidx_sect sect[]; /**< Section descriptors. */
+};
+
+/**  Get the index file name.
+ * @param ctx  Dump file object.
+ * @returns    Index file path, or @c NULL if no index should be used.
+ */
+static const char *
+index_path(kdump_ctx_t *ctx)
+{
+	struct attr_data *attr = gattr(ctx, GKI_file_index);
+
+	if (!attr_isset(attr))
+		return NULL;
+	return attr_value(attr)->string;
+}
+
+/**  Initialize an index header with the dump file identity.
+ * @param ctx   Dump file object.
+ * @param hdr   Index header (updated).
+ * @param hash  Hash of format-specific header data.
+ * @returns     Error status.
+ */
+static kdump_status
+init_header(kdump_ctx_t *ctx, struct kdidx_header *hdr, unsigned long hash)
+{
+	struct stat st;
+
+	if (fstat(get_file_fd(ctx), &st))
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot stat dump file: %s",
+				 strerror(errno));
+
+	memset(hdr, 0, sizeof *hdr);
+	memcpy(hdr->magic, KDIDX_MAGIC, sizeof hdr->magic);
+	hdr->version = KDIDX_VERSION;
+	hdr->bom = KDIDX_BOM;
+	hdr->off_size = sizeof(off_t);
+	hdr->file_size = st.st_size;
+	hdr->mtime_sec = st.st_mtim.tv_sec;
+	hdr->mtime_nsec = st.st_mtim.tv_nsec;
+	hdr->hash = hash;
+	return KDUMP_OK;
+}
+
+/**  Open and validate the sidecar index of a dump file.
+ * @param ctx   Dump file object.
+ * @param hash  Hash of format-specific header data.
+ * @param idx   Index, filled on success.
+ * @returns     Error status.
+ *
+ * The index is mapped into memory, so that sections can be used
+ * directly as read-only arrays. @c KDUMP_ERR_NODATA is returned if
+ * no index file is configured, if the file does not exist, or if it
+ * does not match the dump file (size, modification time or header
+ * hash differ). This is not an error condition for the caller, who
+ * should build the data from the dump file instead.
+ */
+kdump_status
+kdidx_open(kdump_ctx_t *ctx, unsigned long hash, struct kdidx *idx)
+{
+	const struct kdidx_header *hdr;
+	struct kdidx_header expect;
+	const char *path;
+	struct stat st;
+	kdump_status ret;
+	unsigned i;
+	int fd;
+
+	path = index_path(ctx);
+	if (!path)
+		return set_error(ctx, KDUMP_ERR_NODATA, "No index file");
+
+	ret = init_header(ctx, &expect, hash);
+	if (ret != KDUMP_OK)
+		return ret;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return set_error(ctx, KDUMP_ERR_NODATA,
+				 "Cannot open index %s: %s",
+				 path, strerror(errno));
+	if (fstat(fd, &st) || st.st_size < sizeof *hdr) {
+		close(fd);
+		return set_error(ctx, KDUMP_ERR_NODATA,
+				 "Index %s too short", path);
+	}
+
+	idx->size = st.st_size;
+	idx->map = mmap(NULL, idx->size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (idx->map == MAP_FAILED)
+		return set_error(ctx, KDUMP_ERR_NODATA,
+				 "Cannot map index %s: %s",
+				 path, strerror(errno));
+
+	hdr = idx->map;
+	if (memcmp(hdr, &expect, offsetof(struct kdidx_header, nsect)) ||
+	    memcmp(&hdr->file_size, &expect.file_size,
+		   sizeof *hdr - offsetof(struct kdidx_header, file_size)))
+		goto stale;
+
+	if (hdr->nsect > (idx->size - sizeof *hdr) / sizeof *hdr->sect)
+		goto stale;
+	for (i = 0; i < hdr->nsect; ++i)
+		if (hdr->sect[i].off > idx->size ||
+		    hdr->sect[i].len > idx->size - hdr->sect[i].off ||
+		    hdr->sect[i].off % KDIDX_ALIGN)
+			goto stale;
+
+	return KDUMP_OK;
+
+ stale:
+	kdidx_close(idx);
+	return set_error(ctx, KDUMP_ERR_NODATA,
+			 "Index %s does not match the dump file", path);
+}
+
+/**  Get an index section.
+ * @param idx  Open index.
+ * @param id   Section identifier.
+ * @param len  Set to the section length on success.
+ * @returns    Section data, or @c NULL if not found.
+ */
+const void *
+kdidx_section(const struct kdidx *idx, unsigned id, size_t *len)
+{
+	const struct kdidx_header *hdr = idx->map;
+	unsigned i;
+
+	for (i = 0; i < hdr->nsect; ++i)
+		if (hdr->sect[i].id == id) {
+			*len = hdr->sect[i].len;
+			return idx->map + hdr->sect[i].off;
+		}
+	return NULL;
+}
+
+/**  Close an index.
+ * @param idx  Open index.
+ *
+ * Section data must not be used after calling this function.
+ */
+void
+kdidx_close(struct kdidx *idx)
+{
+	munmap(idx->map, idx->size);
+	idx->map = NULL;
+}
+
+/**  Write all data to a file descriptor.
+ * @param fd   File descriptor.
+ * @param buf  Data.
+ * @param len  Length of data.
+ * @returns    Zero on success, -1 on error (see @c errno).
+ */
+static int
+write_all(int fd, const void *buf, size_t len)
+{
+	while (len) {
+		ssize_t wr = write(fd, buf, len);
+		if (wr < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += wr;
+		len -= wr;
+	}
+	return 0;
+}
+
+/**  Write the sidecar index of a dump file.
+ * @param ctx    Dump file object.
+ * @param hash   Hash of format-specific header data.
+ * @param sects  Section data.
+ * @param nsect  Number of elements in @p sects.
+ * @returns      Error status.
+ *
+ * The index is written to a temporary file, which then replaces the
+ * index file, so concurrent readers never see a partial index.
+ */
+kdump_status
+kdidx_write(kdump_ctx_t *ctx, unsigned long hash,
+	    const struct kdidx_data *sects, unsigned nsect)
+{
+	static const char zeroes[KDIDX_ALIGN];
+	struct kdidx_header *hdr;
+	const char *path;
+	char *tmppath;
+	size_t hdrsz;
+	uint64_t off;
+	kdump_status ret;
+	unsigned i;
+	int fd;
+
+	path = index_path(ctx);
+	if (!path)
+		return KDUMP_OK;
+
+	hdrsz = sizeof *hdr + nsect * sizeof *hdr->sect;
+	hdr = calloc(1, hdrsz);
+	if (!hdr)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate index header");
+	ret = init_header(ctx, hdr, hash);
+	if (ret != KDUMP_OK)
+		goto out_hdr;
+
+	hdr->nsect = nsect;
+	off = hdrsz;
+	for (i = 0; i < nsect; ++i) {
+		off = (off + KDIDX_ALIGN - 1) & ~(uint64_t)(KDIDX_ALIGN - 1);
+		hdr->sect[i].id = sects[i].id;
+		hdr->sect[i].off = off;
+		hdr->sect[i].len = sects[i].len;
+		off += sects[i].len;
+	}
+
+	if (asprintf(&tmppath, "%s.XXXXXX", path) < 0) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot allocate index file name");
+		goto out_hdr;
+	}
+	fd = mkstemp(tmppath);
+	if (fd < 0) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot create %s: %s",
+				tmppath, strerror(errno));
+		goto out_path;
+	}
+
+	off = hdrsz;
+	if (write_all(fd, hdr, hdrsz))
+		goto err_write;
+	for (i = 0; i < nsect; ++i) {
+		if (write_all(fd, zeroes, hdr->sect[i].off - off) ||
+		    write_all(fd, sects[i].data, sects[i].len))
+			goto err_write;
+		off = hdr->sect[i].off + sects[i].len;
+	}
+	if (close(fd)) {
+		fd = -1;
+		goto err_write;
+	}
+
+	if (rename(tmppath, path)) {
+		ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+				"Cannot rename %s to %s: %s",
+				tmppath, path, strerror(errno));
+		unlink(tmppath);
+	}
+	goto out_path;
+
+ err_write:
+	ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+			"Cannot write %s: %s", tmppath, strerror(errno));
+	if (fd >= 0)
+		close(fd);
+	unlink(tmppath);
+
+ out_path:
+	free(tmppath);
+ out_hdr:
+	free(hdr);
+	return ret;
+}
@@ -545,6 +545,14 @@ struct cache;
  */
 #define PER_CTX_SLOTS	16
 
+/**  Per-context data destructor.
+ * @param data  Per-context data.
+ *
+ * This function must release any resources referenced from @p data.
+ * The data itself is freed by the caller.
+ */
+typedef void per_ctx_cleanup_fn(void *data);
+
 /**  Shared state of the dump file object.
  *
  * This structure describes the data portion of the dump file object,
@@ -573,7 +581,20 @@ struct kdump_shared {
 
 	struct cache *cache;	/**< Page cache. */
 	struct fcache *fcache;	/**< File cache. */
-	mutex_t cache_lock;	/**< Cache access lock. */
+
+	/** Additional file descriptors of a split dump.
+	 * These are set only while the dump is being opened by
+	 * @ref kdump_open_fdset.
+	 */
+	const int *split_fds;
+	unsigned nsplit_fds;	/**< Number of elements in @c split_fds. */
+
+	/** Shared read-only page of zeroes, or @c NULL.
+	 * The page is @ref MAX_PAGE_SIZE bytes long, so it can be
+	 * used with any page size.
+	 * @sa get_zero_page
+	 */
+	void *zero_page;
 
 	/** Static attributes. */
 #define ATTR(dir, key, field, type, ctype, ...)	\
@@ -583,6 +604,9 @@ struct kdump_shared {
 
 	/** Size of per-context data. Zero means unallocated. */
 	size_t per_ctx_size[PER_CTX_SLOTS];
+
+	/** Per-context data destructors, or @c NULL. */
+	per_ctx_cleanup_fn *per_ctx_cleanup[PER_CTX_SLOTS];
 };
 
 INTERNAL_DECL(void, shared_free,
@@ -680,6 +704,85 @@ xlat_decref(struct kdump_xlat *xlat)
  * This structure contains state information and a pointer to @c struct
  * @ref kdump_shared.
  */
+/** Number of sets in the translation lookaside buffer. */
+#define TLB_SETS	32
+
+/** Number of entries in each translation lookaside buffer set. */
+#define TLB_WAYS	4
+
+/** Maximum number of distinct page sizes in the TLB. */
+#define TLB_SIZES	4
+
+/**  Translation lookaside buffer entry.
+ */
+struct tlb_entry {
+	/** Virtual address shifted right by @c shift. */
+	kdump_addr_t vpn;
+
+	/** Translated address of the page start. */
+	addrxlat_fulladdr_t phys;
+
+	/** Log2 of the page size, or zero if the entry is unused. */
+	unsigned char shift;
+};
+
+/**  Translation lookaside buffer.
+ *
+ * This is a small set-associative cache of virtual-to-physical page
+ * translations. Each entry covers a page of the size that was found
+ * by the page table walk, so a single entry covers a whole huge page.
+ */
+struct kdump_tlb {
+	/** Translation system generation of the cached entries.
+	 * @sa addrxlat_sys_get_gen
+	 */
+	unsigned long gen;
+
+	/** Address space capabilities of the cached entries. */
+	unsigned long caps;
+
+	/** Set while a page table walk is in progress. */
+	bool busy;
+
+	/** Number of valid elements in @c shift. */
+	unsigned char nsizes;
+
+	/** Page sizes (log2) used by TLB entries. */
+	unsigned char shift[TLB_SIZES];
+
+	/** Next replacement victim in each set. */
+	unsigned char next[TLB_SETS];
+
+	/** TLB entries. */
+	struct tlb_entry entry[TLB_SETS][TLB_WAYS];
+};
+
+INTERNAL_DECL(void, tlb_translate,
+	      (kdump_ctx_t *ctx, addrxlat_fulladdr_t *addr));
+
+/**  Sequential read detection state.
+ */
+struct read_stream {
+	kdump_addrspace_t as;	/**< Address space of the last page. */
+	kdump_addr_t next;	/**< Address of the next sequential page. */
+	kdump_addr_t ahead;	/**< End of the requested readahead. */
+	unsigned run;		/**< Number of sequential pages so far. */
+
+	kdump_addr_t req_addr;	  /**< First page of a pending request. */
+	unsigned long req_count;  /**< Number of pages in the request. */
+
+	/** A request is waiting for the readahead thread to start. */
+	bool pending;
+
+	/** Background readahead is not available. */
+	bool sync;
+};
+
+/* Readahead thread state (opaque). */
+struct readahead;
+
+INTERNAL_DECL(void, readahead_free, (kdump_ctx_t *ctx));
+
 struct _kdump_ctx {
 	struct kdump_shared *shared; /**< Dump file shared data. */
 
@@ -697,6 +800,15 @@ struct _kdump_ctx {
 	/** Address translation context. */
 	addrxlat_ctx_t *xlatctx;
 
+	/** Translation lookaside buffer for kernel virtual addresses. */
+	struct kdump_tlb tlb;
+
+	/** Sequential read detection. */
+	struct read_stream stream;
+
+	/** Readahead thread, or @c NULL if not started. */
+	struct readahead *ra;
+
 	/** Per-context data. */
 	void *data[PER_CTX_SLOTS];
 
@@ -707,8 +819,11 @@ struct _kdump_ctx {
 
 /* Per-context data */
 
-INTERNAL_DECL(int, per_ctx_alloc, (struct kdump_shared *shared, size_t sz));
+INTERNAL_DECL(int, per_ctx_alloc, (struct kdump_shared *shared, size_t sz,
+				    per_ctx_cleanup_fn *cleanup));
 INTERNAL_DECL(void, per_ctx_free, (struct kdump_shared *shared, int slot));
+INTERNAL_DECL(void, per_ctx_release,
+	      (struct kdump_shared *shared, int slot, void *data));
 
 /* File formats */
 
@@ -723,6 +838,40 @@ INTERNAL_DECL(extern const struct format_ops, mclxcd_ops, );
 INTERNAL_DECL(extern const struct format_ops, s390dump_ops, );
 INTERNAL_DECL(extern const struct format_ops, devmem_ops, );
 
+/* File layers */
+
+INTERNAL_DECL(kdump_status, flattened_open, (kdump_ctx_t *ctx));
+
+/* Sidecar index */
+
+/** Sidecar index section identifiers. */
+enum kdidx_section_id {
+	KDIDX_DISKDUMP_RGN = 1,	/**< Diskdump PFN region map. */
+	KDIDX_DISKDUMP_NDESC,	/**< Diskdump page descriptor count. */
+};
+
+/** Memory-mapped sidecar index. */
+struct kdidx {
+	void *map;		/**< Mapped index file. */
+	size_t size;		/**< Size of the mapping. */
+};
+
+/** Sidecar index section data (for writing). */
+struct kdidx_data {
+	unsigned id;		/**< Section identifier. */
+	const void *data;	/**< Section data. */
+	size_t len;		/**< Length of @c data. */
+};
+
+INTERNAL_DECL(kdump_status, kdidx_open,
+	      (kdump_ctx_t *ctx, unsigned long hash, struct kdidx *idx));
+INTERNAL_DECL(const void *, kdidx_section,
+	      (const struct kdidx *idx, unsigned id, size_t *len));
+INTERNAL_DECL(void, kdidx_close, (struct kdidx *idx));
+INTERNAL_DECL(kdump_status, kdidx_write,
+	      (kdump_ctx_t *ctx, unsigned long hash,
+	       const struct kdidx_data *sects, unsigned nsect));
+
 INTERNAL_DECL(kdump_status, linux_iomem_kcode,
 	      (kdump_ctx_t *ctx, kdump_paddr_t *paddr));
 
@@ -777,8 +926,9 @@ INTERNAL_DECL(int, uts_looks_sane, (struct new_utsname *uts));
 INTERNAL_DECL(int, uncompress_rle,
 	      (unsigned char *dst, size_t *pdstlen,
 	       const unsigned char *src, size_t srclen));
+INTERNAL_DECL(int, gzip_slot_alloc, (struct kdump_shared *shared));
 INTERNAL_DECL(kdump_status, uncompress_page_gzip,
-	      (kdump_ctx_t *ctx, unsigned char *dst,
+	      (kdump_ctx_t *ctx, int slot, unsigned char *dst,
 	       unsigned char *src, size_t srclen));
 
 INTERNAL_DECL(uint32_t, cksum32, (void *buffer, size_t size, uint32_t csum));
@@ -1141,6 +1291,9 @@ INTERNAL_DECL(extern const struct attr_ops, file_fd_ops, );
 INTERNAL_DECL(extern const struct attr_ops, page_size_ops, );
 INTERNAL_DECL(extern const struct attr_ops, page_shift_ops, );
 INTERNAL_DECL(extern const struct attr_ops, cache_size_ops, );
+INTERNAL_DECL(extern const struct attr_ops, cache_shards_ops, );
+INTERNAL_DECL(extern const struct attr_ops, cache_full_policy_ops, );
+INTERNAL_DECL(extern const struct attr_ops, cache_readahead_window_ops, );
 INTERNAL_DECL(extern const struct attr_ops, arch_name_ops, );
 INTERNAL_DECL(extern const struct attr_ops, ostype_ops, );
 INTERNAL_DECL(extern const struct attr_ops, uts_machine_ops, );
@@ -1201,6 +1354,16 @@ typedef kdump_addr_t	cache_key_t;
  */
 #define DEFAULT_CACHE_SIZE	1024
 
+/** Default number of cache shards.
+ * A single shard is best for single-threaded use. Applications which
+ * read concurrently from many threads may reduce lock contention by
+ * splitting the cache into more shards.
+ */
+#define DEFAULT_CACHE_SHARDS	1
+
+/** Default readahead window (in pages). */
+#define DEFAULT_READAHEAD_WINDOW	16
+
 /**  Cache entry state.
  */
 enum cache_state {
@@ -1216,7 +1379,10 @@ struct cache_entry {
 	enum cache_state state;	/**< Cache entry state. */
 	unsigned next;		/**< Index of next entry in evict list. */
 	unsigned prev;		/**< Index of previous entry in evict list. */
-	unsigned refcnt;	/**< Reference count. */
+	unsigned hnext;		/**< Index of next entry in hash chain. */
+	unsigned refcnt;	/**< Reference count (updated atomically). */
+	unsigned char referenced; /**< Hit without holding the cache lock. */
+	unsigned char elastic;	/**< Temporary entry outside the cache. */
 	void *data;		/**< Pointer to data. */
 };
 
@@ -1228,16 +1394,27 @@ struct cache_entry {
 typedef void cache_entry_cleanup_fn(void *data, struct cache_entry *ce);
 
 INTERNAL_DECL(unsigned, get_cache_size, (kdump_ctx_t *ctx));
+INTERNAL_DECL(unsigned, get_cache_shards, (kdump_ctx_t *ctx));
 INTERNAL_DECL(struct cache *, cache_alloc, (unsigned n, size_t size));
+INTERNAL_DECL(struct cache *, cache_alloc_sharded,
+	      (unsigned n, size_t size, unsigned nshards));
 INTERNAL_DECL(void, set_cache_entry_cleanup,
 	      (struct cache *, cache_entry_cleanup_fn *, void *));
+INTERNAL_DECL(void, set_cache_full_policy,
+	      (struct cache *, kdump_cache_full_policy_t));
 INTERNAL_DECL(void, cache_free, (struct cache *));
 INTERNAL_DECL(void, cache_flush, (struct cache *));
 INTERNAL_DECL(struct cache_entry *, cache_get_entry,
 	      (struct cache *, cache_key_t));
+INTERNAL_DECL(struct cache_entry *, cache_lookup_entry,
+	      (struct cache *, cache_key_t));
 INTERNAL_DECL(void, cache_put_entry,
 	      (struct cache *cache, struct cache_entry *entry));
 INTERNAL_DECL(void, cache_insert, (struct cache *, struct cache_entry *));
+INTERNAL_DECL(int, cache_insert_data,
+	      (struct cache *, struct cache_entry *, void *data));
+INTERNAL_DECL(void, cache_insert_copy,
+	      (struct cache *, struct cache_entry *, const void *data));
 INTERNAL_DECL(void, cache_discard, (struct cache *, struct cache_entry *));
 
 INTERNAL_DECL(kdump_status, cache_set_attrs,
@@ -1273,6 +1450,15 @@ struct fcache_entry {
 	struct cache *cache;
 };
 
+/** Extent of a logical file.
+ * @sa fcache
+ */
+struct fcache_extent {
+	off_t pos;		/**< Position in the logical file. */
+	off_t phys;		/**< Position in the underlying file. */
+	off_t len;		/**< Length of the extent. */
+};
+
 /** File cache.
  */
 struct fcache {
@@ -1301,12 +1487,45 @@ struct fcache {
 
 	/** Fallback cache (for read regions). */
 	struct cache *fbcache;
+
+	/** Logical file extents, sorted by position, or @c NULL.
+	 * If set, file positions refer to a logical file, which is
+	 * scattered in the underlying file as described by this map.
+	 * Gaps between extents read as zeroes. Such files are always
+	 * read with read(2).
+	 */
+	struct fcache_extent *ext;
+	size_t next;		/**< Number of elements in @c ext. */
 };
 
+/** File cache size.
+ * This number should be big enough to cover page table lookups with a
+ * scattered page table hierarchy, including a possible Xen mtop lookup
+ * in a separate hierarchy. The worst case seems to be 4-level paging with
+ * a subsequent lookup (4-level paging again, plus the lookup page) and
+ * a data page. That is 4 + 1 + 4 + 1 = 10. Let's add some reserve and use
+ * a beautirul power of two.
+ */
+#define FCACHE_SIZE	16
+
+/** File cache page order.
+ * This number should be high enough to leverage transparent huge pages in
+ * the kernel (if possible), but small enough not to exhaust the virtual
+ * address space (especially on 32-bit platforms).
+ * Choosing 10 here results in 4M blocks on architectures with 4K pages
+ * and 64M blocks on architectures with 64K pages. In the latter case,
+ * virtual address space may a bit tight on a 32-bit platform.
+ */
+#define FCACHE_ORDER	10
+
 INTERNAL_DECL(struct fcache *, fcache_new,
 	      (int fd, unsigned n, unsigned order));
 INTERNAL_DECL(void, fcache_free,
 	      (struct fcache *fc));
+INTERNAL_DECL(void, fcache_set_extents,
+	      (struct fcache *fc, struct fcache_extent *ext, size_t next));
+INTERNAL_DECL(ssize_t, fcache_read_direct,
+	      (struct fcache *fc, void *buf, size_t len, off_t pos));
 
 /** Increment file cache reference counter.
  * @param fc  File cache.
@@ -1386,6 +1605,14 @@ INTERNAL_DECL(void, fcache_put_chunk, (struct fcache_chunk *fch));
 struct page_io {
 	addrxlat_fulladdr_t addr;  /**< Address of page under I/O. */
 	struct fcache_chunk chunk; /**< File cache chunk. */
+
+	/** Buffer for a streaming read, or @c NULL.
+	 * If non-null, pages which are not cached may be read directly
+	 * into this buffer, bypassing the cache. In that case,
+	 * @c chunk.data is set to @c buf, and the page must not be
+	 * released with @ref put_page.
+	 */
+	void *buf;
 };
 
 typedef kdump_status read_page_fn(
@@ -1395,6 +1622,8 @@ INTERNAL_DECL(kdump_status, cache_get_page,
 	      (kdump_ctx_t *ctx, struct page_io *pio, read_page_fn *fn));
 INTERNAL_DECL(void, cache_put_page,
 	      (kdump_ctx_t *ctx, struct page_io *pio));
+INTERNAL_DECL(kdump_status, get_zero_page,
+	      (kdump_ctx_t *ctx, struct page_io *pio));
 
 /** Get page data.
  * @param ctx  Dump file object.
@@ -310,6 +310,26 @@ struct pfn_block {
 
 #define MAX_PFN_GAP 15
 
+/** Size of the read buffer of the background indexer. */
+#define INDEX_BUFSZ		(1UL << 20)
+
+/** Minimum size of a file part scanned by a separate thread. */
+#define INDEX_PART_MIN		(4 * INDEX_BUFSZ)
+
+/** Maximum number of background indexer threads. */
+#define INDEX_MAX_THREADS	16
+
+/** Number of page descriptors added to the PFN tables at once. */
+#define INDEX_BATCH		1024
+
+/** Number of chained page descriptors needed to find a descriptor
+ * at an unknown file position.
+ */
+#define INDEX_SYNC_DESC		8
+
+/** Size of the fallback error buffer of the background indexer. */
+#define INDEX_ERRBUF		80
+
 /* Maximum size of the format name: the version field is a 32-bit integer,
  * so it cannot be longer than 10 decimal digits.
  */
@@ -328,9 +348,17 @@ struct lkcd_priv {
 	struct pfn_block ***pfn_level1;
 	unsigned l1_size;
 
+	/** Signalled when the background indexer adds pages. */
+	cond_t pfn_block_cond;
+	/** Background indexer, or @c NULL. */
+	struct lkcd_indexer *indexer;
+	/** Set while the background indexer owns @c last_offset. */
+	bool indexing;
+
 	/** Overridden methods for arch.page_size attribute. */
 	struct attr_override page_size_override;
 	int cbuf_slot;		/**< Compressed data per-context slot. */
+	int zlib_slot;		/**< Zlib decompression state slot. */
 
 	/** Overridden methods for max.pfn attribute. */
 	struct attr_override max_pfn_override;
@@ -342,9 +370,8 @@ struct lkcd_priv {
 static void lkcd_cleanup(struct kdump_shared *shared);
 
 static struct pfn_block **
-get_pfn_slot(kdump_ctx_t *ctx, kdump_pfn_t pfn)
+get_pfn_slot(struct lkcd_priv *lkcdp, kdump_errmsg_t *err, kdump_pfn_t pfn)
 {
-	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
 	struct pfn_block **l2;
 	unsigned idx;
 
@@ -354,8 +381,8 @@ get_pfn_slot(kdump_ctx_t *ctx, kdump_pfn_t pfn)
 		new_l1 = realloc(lkcdp->pfn_level1,
 				 (idx + 1) * sizeof(*new_l1));
 		if (!new_l1) {
-			set_error(ctx, KDUMP_ERR_SYSTEM,
-				  "Cannot allocate PFN level-%u table", 1);
+			status_err(err, KDUMP_ERR_SYSTEM,
+				   "Cannot allocate PFN level-%u table", 1);
 			return NULL;
 		}
 
@@ -369,8 +396,8 @@ get_pfn_slot(kdump_ctx_t *ctx, kdump_pfn_t pfn)
 	if (!l2) {
 		l2 = calloc(PFN_IDX2_SIZE, sizeof(struct pfn_block*));
 		if (!l2) {
-			set_error(ctx, KDUMP_ERR_SYSTEM,
-				  "Cannot allocate PFN level-%u table", 2);
+			status_err(err, KDUMP_ERR_SYSTEM,
+				   "Cannot allocate PFN level-%u table", 2);
 			return NULL;
 		}
 		lkcdp->pfn_level1[idx] = l2;
@@ -380,15 +407,29 @@ get_pfn_slot(kdump_ctx_t *ctx, kdump_pfn_t pfn)
 }
 
 static struct pfn_block *
-alloc_pfn_block(kdump_ctx_t *ctx, kdump_pfn_t pfn)
+new_pfn_block(kdump_errmsg_t *err)
+{
+	struct pfn_block *block;
+
+	block = malloc(sizeof(struct pfn_block));
+	if (!block)
+		status_err(err, KDUMP_ERR_SYSTEM,
+			   "Cannot allocate PFN block (%zu bytes)",
+			   sizeof(struct pfn_block));
+	return block;
+}
+
+static struct pfn_block *
+alloc_pfn_block(struct lkcd_priv *lkcdp, kdump_errmsg_t *err,
+		kdump_pfn_t pfn)
 {
 	struct pfn_block **pprev, *block;
 
-	pprev = get_pfn_slot(ctx, pfn);
+	pprev = get_pfn_slot(lkcdp, err, pfn);
 	if (!pprev)
 		return NULL;
 
-	block = ctx_malloc(sizeof(struct pfn_block), ctx, "PFN block");
+	block = new_pfn_block(err);
 	if (!block)
 		return NULL;
 
@@ -430,20 +471,20 @@ realloc_pfn_offs(struct pfn_block *block, unsigned short alloc)
 }
 
 static kdump_status
-error_pfn_offs(kdump_ctx_t *ctx, kdump_status res)
+error_pfn_offs(kdump_errmsg_t *err, kdump_status res)
 {
-	return set_error(ctx, res, "Cannot allocate PFN block offs");
+	return status_err(err, res, "Cannot allocate PFN block offs");
 }
 
 static kdump_status
-alloc_tail_pfn_block(kdump_ctx_t *ctx, struct pfn_block *block,
+alloc_tail_pfn_block(kdump_errmsg_t *err, struct pfn_block *block,
 		     unsigned short idx, unsigned short nextidx)
 {
 	struct pfn_block *next;
 	uint32_t blockoff;
 	kdump_status res;
 
-	next = ctx_malloc(sizeof(struct pfn_block), ctx, "PFN block");
+	next = new_pfn_block(err);
 	if (!next)
 		return KDUMP_ERR_SYSTEM;
 
@@ -454,7 +495,7 @@ alloc_tail_pfn_block(kdump_ctx_t *ctx, struct pfn_block *block,
 	res = realloc_pfn_offs(next, next->n);
 	if (res != KDUMP_OK) {
 		free(next);
-		return error_pfn_offs(ctx, res);
+		return error_pfn_offs(err, res);
 	}
 
 	blockoff = block->offs[nextidx];
@@ -469,7 +510,8 @@ alloc_tail_pfn_block(kdump_ctx_t *ctx, struct pfn_block *block,
 }
 
 static kdump_status
-split_pfn_block(kdump_ctx_t *ctx, struct pfn_block *block, unsigned short idx)
+split_pfn_block(kdump_errmsg_t *err, struct pfn_block *block,
+		unsigned short idx)
 {
 	unsigned short nextidx;
 	kdump_status res;
@@ -478,7 +520,7 @@ split_pfn_block(kdump_ctx_t *ctx, struct pfn_block *block, unsigned short idx)
 	while (nextidx < block->n && block->offs[nextidx] == 0)
 		++nextidx;
 	if (nextidx < block->n) {
-		res = alloc_tail_pfn_block(ctx, block, idx, nextidx);
+		res = alloc_tail_pfn_block(err, block, idx, nextidx);
 		if (res != KDUMP_OK)
 			return res;
 	}
@@ -490,9 +532,9 @@ split_pfn_block(kdump_ctx_t *ctx, struct pfn_block *block, unsigned short idx)
 }
 
 static struct pfn_block *
-lookup_pfn_block(kdump_ctx_t *ctx, kdump_pfn_t pfn, unsigned short tolerance)
+lookup_pfn_block(struct lkcd_priv *lkcdp, kdump_pfn_t pfn,
+		 unsigned short tolerance)
 {
-	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
 	struct pfn_block **l2, *block;
 	unsigned idx;
 
@@ -559,17 +601,118 @@ read_page_desc(kdump_ctx_t *ctx, struct dump_page *dp, off_t off)
 }
 
 static kdump_status
-error_dup(kdump_ctx_t *ctx, off_t off, struct pfn_block *block, kdump_pfn_t pfn)
+error_dup(kdump_errmsg_t *err, off_t off, struct pfn_block *block,
+	  kdump_pfn_t pfn)
 {
 	off_t prevoff = block->filepos;
 	unsigned idx = pfn_idx3(pfn);
 	if (idx > block->idx3)
 		prevoff += block->offs[idx - block->idx3 - 1];
-	return set_error(ctx, KDUMP_ERR_CORRUPT,
-			 "Duplicate PFN 0x%llx at %lld (previous %lld)",
-			 (unsigned long long) pfn,
-			 (unsigned long long) off,
-			 (unsigned long long) prevoff);
+	return status_err(err, KDUMP_ERR_CORRUPT,
+			  "Duplicate PFN 0x%llx at %lld (previous %lld)",
+			  (unsigned long long) pfn,
+			  (unsigned long long) off,
+			  (unsigned long long) prevoff);
+}
+
+/**  State of adding page descriptors to the PFN tables.
+ */
+struct pfn_adder {
+	struct lkcd_priv *lkcdp;	/**< LKCD private data. */
+	kdump_errmsg_t *err;		/**< Error message buffer. */
+	struct pfn_block *block;	/**< Current PFN block, or @c NULL. */
+	kdump_pfn_t blocktbl;		/**< First PFN of @c block's table. */
+};
+
+/**  Initialize a PFN table adder.
+ * @param add    Adder state.
+ * @param lkcdp  LKCD private data.
+ * @param err    Error message buffer.
+ */
+static void
+init_pfn_adder(struct pfn_adder *add, struct lkcd_priv *lkcdp,
+	       kdump_errmsg_t *err)
+{
+	add->lkcdp = lkcdp;
+	add->err = err;
+	add->block = NULL;
+}
+
+/**  Add a page descriptor to the PFN tables.
+ * @param add  Adder state.
+ * @param pfn  Page frame number.
+ * @param off  File offset of the page descriptor.
+ * @returns    Error status.
+ *
+ * Descriptors must be added in file order. Consecutive descriptors
+ * usually go to the same PFN block, which is remembered in @p add.
+ * The caller must hold @c pfn_block_mutex.
+ */
+static kdump_status
+add_page_desc(struct pfn_adder *add, kdump_pfn_t pfn, off_t off)
+{
+	struct lkcd_priv *lkcdp = add->lkcdp;
+	struct pfn_block *block = add->block;
+	unsigned short idx;
+	kdump_status res;
+
+	if (!block)
+		block = lookup_pfn_block(lkcdp, pfn, MAX_PFN_GAP);
+	else if (add->blocktbl != (pfn & ~PFN_IDX3_MASK) ||
+		 !idx_fits_block(pfn_idx3(pfn), block)) {
+		realloc_pfn_offs(block, block->n);
+		block = lookup_pfn_block(lkcdp, pfn, MAX_PFN_GAP);
+	}
+	if (block && off > block->filepos + UINT32_MAX) {
+		idx = pfn_idx3(pfn) - block->idx3;
+		res = split_pfn_block(add->err, block, idx);
+		if (res != KDUMP_OK)
+			return status_err(add->err, res,
+					  "Cannot split PFN block");
+		block = NULL;
+	}
+	if (block) {
+		idx = pfn_idx3(pfn) - block->idx3;
+		if (!idx--)
+			return error_dup(add->err, off, block, pfn);
+		if (idx >= block->n)
+			block->n = idx + 1;
+		if (block->n >= block->alloc) {
+			res = realloc_pfn_offs(block, PFN_IDX3_SIZE);
+			if (res != KDUMP_OK)
+				return error_pfn_offs(add->err, res);
+		}
+	}
+
+	add->blocktbl = pfn & ~PFN_IDX3_MASK;
+	if (!block) {
+		block = alloc_pfn_block(lkcdp, add->err, pfn);
+		if (!block)
+			return KDUMP_ERR_SYSTEM;
+		block->filepos = off;
+	} else if (block->offs[idx] == 0)
+		block->offs[idx] = off - block->filepos;
+	else
+		return error_dup(add->err, off, block, pfn);
+	add->block = block;
+
+	if (pfn >= lkcdp->max_pfn)
+		lkcdp->max_pfn = pfn + 1;
+
+	return KDUMP_OK;
+}
+
+/**  Finish adding page descriptors to the PFN tables.
+ * @param add  Adder state.
+ *
+ * Free unused space in the current PFN block.
+ */
+static void
+end_page_descs(struct pfn_adder *add)
+{
+	if (add->block)
+		realloc_pfn_offs(add->block, add->block->n);
+	add->block = NULL;
 }
 
 static kdump_status
@@ -577,85 +720,517 @@ search_page_desc(kdump_ctx_t *ctx, kdump_pfn_t pfn,
 		 struct dump_page *dp, off_t *dataoff)
 {
 	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct pfn_adder add;
+	kdump_pfn_t curpfn;
 	off_t off;
-	kdump_pfn_t curpfn, blocktbl;
-	struct pfn_block *block;
-	unsigned short idx;
 	kdump_status res;
 
 	off = lkcdp->last_offset;
 	if (off == lkcdp->end_offset)
 		return set_error(ctx, KDUMP_ERR_NODATA, "Page not found");
 
-	block = NULL;
+	init_pfn_adder(&add, lkcdp, &ctx->err);
 	do {
 		res = read_page_desc(ctx, dp, off);
 		if (res != KDUMP_OK) {
 			if (res == KDUMP_ERR_EOF)
 				lkcdp->end_offset = off;
-			if (block)
-				realloc_pfn_offs(block, block->n);
+			end_page_descs(&add);
 			return res;
 		}
 
 		if (dp->dp_flags & DUMP_END) {
 			lkcdp->end_offset = off;
-			if (block)
-				realloc_pfn_offs(block, block->n);
+			end_page_descs(&add);
 			return set_error(ctx, KDUMP_ERR_NODATA, "Page not found");
 		}
 
 		curpfn = dp->dp_address >> get_page_shift(ctx);
-		if (!block)
-			block = lookup_pfn_block(ctx, curpfn, MAX_PFN_GAP);
-		else if (blocktbl != (curpfn & ~PFN_IDX3_MASK) ||
-			 !idx_fits_block(pfn_idx3(curpfn), block)) {
-			realloc_pfn_offs(block, block->n);
-			block = lookup_pfn_block(ctx, curpfn, MAX_PFN_GAP);
+		res = add_page_desc(&add, curpfn, off);
+		if (res != KDUMP_OK)
+			return res;
+
+		off += sizeof(struct dump_page) + dp->dp_size;
+		lkcdp->last_offset = off;
+	} while (curpfn != pfn);
+
+	*dataoff = off - dp->dp_size;
+	return KDUMP_OK;
+}
+
+/**  Page descriptor found by the background indexer.
+ */
+struct index_ent {
+	kdump_pfn_t pfn;	/**< Page frame number. */
+	off_t off;		/**< File offset of the page descriptor. */
+};
+
+struct lkcd_indexer;
+
+/**  Part of the dump file scanned by one indexer thread.
+ *
+ * Only the first part starts at a known page descriptor. Other parts
+ * are scanned speculatively from the first position which looks like
+ * a chain of page descriptors. The result is used only if this
+ * position is where the scan of the preceding part ended.
+ */
+struct index_part {
+	struct lkcd_indexer *idx; /**< Indexer. */
+	thread_t thread;	/**< Scanning thread. */
+	bool running;		/**< Set if @c thread was started. */
+
+	off_t start;		/**< File offset of the part start. */
+	off_t end;		/**< File offset of the part end. */
+
+	unsigned char *buf;	/**< Read buffer, or @c NULL. */
+	off_t bufpos;		/**< File offset of @c buf. */
+	size_t buflen;		/**< Number of valid bytes in @c buf. */
+
+	off_t first;		/**< Offset of the first descriptor, or -1. */
+	off_t next;		/**< Offset after the last scanned descriptor. */
+	bool done;		/**< Scan reached the end of the part. */
+	bool at_end;		/**< Scan found the end marker. */
+
+	struct index_ent *ent;	/**< Descriptors not yet in PFN tables. */
+	size_t nent;		/**< Number of used elements in @c ent. */
+	size_t allocent;	/**< Number of allocated elements in @c ent. */
+};
+
+/**  Background page descriptor indexer.
+ */
+struct lkcd_indexer {
+	struct lkcd_priv *lkcdp; /**< LKCD private data. */
+	struct fcache *fcache;	/**< File cache (referenced). */
+	thread_t thread;	/**< Main indexer thread. */
+	bool stop;		/**< Request to terminate. */
+
+	unsigned page_shift;	/**< Page shift of the dump. */
+	kdump_byte_order_t byte_order; /**< Byte order of the dump. */
+
+	struct pfn_adder add;	/**< State of adding to the PFN tables. */
+	kdump_errmsg_t *err;	/**< Error buffer (messages are ignored). */
+
+	unsigned nparts;	/**< Number of file parts. */
+	struct index_part part[]; /**< File parts. */
+};
+
+/**  Read a page descriptor through the read buffer of a part.
+ * @param part  File part.
+ * @param off   File offset of the page descriptor.
+ * @param dp    Page descriptor, filled on success.
+ * @returns     @c KDUMP_OK, @c KDUMP_ERR_EOF if there is no descriptor
+ *              at @p off, or another error status.
+ */
+static kdump_status
+read_index_desc(struct index_part *part, off_t off, struct dump_page *dp)
+{
+	struct lkcd_indexer *idx = part->idx;
+	ssize_t rd;
+
+	if (!part->buf) {
+		part->buf = malloc(INDEX_BUFSZ);
+		if (!part->buf)
+			return KDUMP_ERR_SYSTEM;
+		part->buflen = 0;
+	}
+
+	if (off < part->bufpos ||
+	    off + sizeof *dp > part->bufpos + part->buflen) {
+		rd = fcache_read_direct(idx->fcache, part->buf,
+					INDEX_BUFSZ, off);
+		if (rd < 0) {
+			part->buflen = 0;
+			return KDUMP_ERR_SYSTEM;
 		}
-		if (block && off > block->filepos + UINT32_MAX) {
-			idx = pfn_idx3(curpfn) - block->idx3;
-			res = split_pfn_block(ctx, block, idx);
-			if (res != KDUMP_OK)
-				return set_error(ctx, res,
-						 "Cannot split PFN block");
-			block = NULL;
+		part->bufpos = off;
+		part->buflen = rd;
+		if (rd < sizeof *dp)
+			return KDUMP_ERR_EOF;
+	}
+
+	memcpy(dp, part->buf + (off - part->bufpos), sizeof *dp);
+	if (idx->byte_order == KDUMP_BIG_ENDIAN) {
+		dp->dp_address = be64toh(dp->dp_address);
+		dp->dp_size = be32toh(dp->dp_size);
+		dp->dp_flags = be32toh(dp->dp_flags);
+	} else {
+		dp->dp_address = le64toh(dp->dp_address);
+		dp->dp_size = le32toh(dp->dp_size);
+		dp->dp_flags = le32toh(dp->dp_flags);
+	}
+	return KDUMP_OK;
+}
+
+/**  Check whether data looks like a page descriptor.
+ * @param idx  Indexer.
+ * @param dp   Page descriptor.
+ * @returns    Non-zero if @p dp is a plausible page descriptor.
+ */
+static int
+desc_looks_sane(const struct lkcd_indexer *idx, const struct dump_page *dp)
+{
+	unsigned type = dp->dp_flags & (DUMP_COMPRESSED|DUMP_RAW|DUMP_END);
+
+	if (dp->dp_address & (((kdump_addr_t)1 << idx->page_shift) - 1))
+		return 0;
+	if (type == DUMP_RAW)
+		return dp->dp_size == ((size_t)1 << idx->page_shift);
+	if (type == DUMP_COMPRESSED)
+		return dp->dp_size && dp->dp_size <= MAX_PAGE_SIZE;
+	return 0;
+}
+
+/**  Find the first page descriptor in a file part.
+ * @param part  File part.
+ * @param pos   File offset of the descriptor, set on success.
+ * @returns     Error status.
+ *
+ * The first position where @ref INDEX_SYNC_DESC plausible descriptors
+ * are chained is taken. This may be wrong, but it is rare enough, and
+ * a wrong guess is detected when the results are merged.
+ */
+static kdump_status
+find_first_desc(struct index_part *part, off_t *pos)
+{
+	struct dump_page dp;
+	kdump_status ret;
+	off_t start, off;
+	unsigned n;
+
+	for (start = part->start; start < part->end; ++start) {
+		off = start;
+		for (n = 0; n < INDEX_SYNC_DESC; ++n) {
+			ret = read_index_desc(part, off, &dp);
+			if (ret != KDUMP_OK)
+				break;
+			if (!desc_looks_sane(part->idx, &dp))
+				break;
+			off += sizeof dp + dp.dp_size;
+		}
+		if (n == INDEX_SYNC_DESC) {
+			*pos = start;
+			return KDUMP_OK;
 		}
-		if (block) {
-			idx = pfn_idx3(curpfn) - block->idx3;
-			if (!idx--)
-				return error_dup(ctx, off, block, curpfn);
-			if (idx >= block->n)
-				block->n = idx + 1;
-			if (block->n >= block->alloc) {
-				res = realloc_pfn_offs(block, PFN_IDX3_SIZE);
-				if (res != KDUMP_OK)
-					return error_pfn_offs(ctx, res);
+		if (n == 0 && ret != KDUMP_OK)
+			return ret;
+	}
+
+	return KDUMP_ERR_NODATA;
+}
+
+/**  Add a page descriptor to the list of found descriptors.
+ * @param part  File part.
+ * @param pfn   Page frame number.
+ * @param off   File offset of the page descriptor.
+ * @returns     Error status.
+ */
+static kdump_status
+add_index_ent(struct index_part *part, kdump_pfn_t pfn, off_t off)
+{
+	struct index_ent *ent;
+
+	if (part->nent == part->allocent) {
+		size_t alloc = part->allocent
+			? 2 * part->allocent
+			: INDEX_BATCH;
+		ent = realloc(part->ent, alloc * sizeof *ent);
+		if (!ent)
+			return KDUMP_ERR_SYSTEM;
+		part->ent = ent;
+		part->allocent = alloc;
+	}
+
+	ent = &part->ent[part->nent++];
+	ent->pfn = pfn;
+	ent->off = off;
+	return KDUMP_OK;
+}
+
+/**  Add page descriptors found in a part to the PFN tables.
+ * @param part  File part.
+ * @returns     Non-zero on success, zero on failure.
+ *
+ * Descriptors are added in batches, and waiting readers are woken up
+ * after each batch. If a descriptor cannot be added, the remaining
+ * descriptors are dropped, and @c next is moved back to the failed
+ * descriptor, so that the error is reported when a reader scans it.
+ */
+static int
+merge_index_ents(struct index_part *part)
+{
+	struct lkcd_indexer *idx = part->idx;
+	struct lkcd_priv *lkcdp = idx->lkcdp;
+	size_t i, end;
+	int ret;
+
+	i = 0;
+	ret = 1;
+	do {
+		mutex_lock(&lkcdp->pfn_block_mutex);
+
+		end = i + INDEX_BATCH;
+		if (end > part->nent)
+			end = part->nent;
+		while (i < end) {
+			if (add_page_desc(&idx->add, part->ent[i].pfn,
+					  part->ent[i].off) != KDUMP_OK) {
+				err_clear(idx->err);
+				part->next = part->ent[i].off;
+				ret = 0;
+				break;
 			}
+			++i;
 		}
 
-		blocktbl = curpfn & ~PFN_IDX3_MASK;
-		if (!block) {
-			block = alloc_pfn_block(ctx, curpfn);
-			if (!block)
-				return KDUMP_ERR_SYSTEM;
-			block->filepos = off;
-		} else if (block->offs[idx] == 0)
-			block->offs[idx] = off - block->filepos;
-		else
-			return error_dup(ctx, off, block, curpfn);
+		if (ret && i < part->nent)
+			lkcdp->last_offset = part->ent[i].off;
+		else {
+			lkcdp->last_offset = part->next;
+			if (ret && part->at_end)
+				lkcdp->end_offset = part->next;
+		}
 
-		if (curpfn >= lkcdp->max_pfn)
-			lkcdp->max_pfn = curpfn + 1;
+		cond_broadcast(&lkcdp->pfn_block_cond);
+		mutex_unlock(&lkcdp->pfn_block_mutex);
+	} while (ret && i < part->nent);
 
-		off += sizeof(struct dump_page) + dp->dp_size;
-		lkcdp->last_offset = off;
-	} while (curpfn != pfn);
+	part->nent = 0;
+	return ret;
+}
 
-	*dataoff = off - dp->dp_size;
+/**  Scan page descriptors in a file part.
+ * @param part   File part.
+ * @param pos    File offset of the first page descriptor.
+ * @param merge  If non-zero, add descriptors to the PFN tables
+ *               as soon as a batch is complete.
+ *
+ * The scan stops at the first descriptor which starts at or beyond
+ * the end of the part (setting @c done), at the end marker (setting
+ * @c at_end), or on error. The stop position is stored in @c next.
+ */
+static void
+scan_index_part(struct index_part *part, off_t pos, int merge)
+{
+	struct lkcd_indexer *idx = part->idx;
+	struct dump_page dp;
+
+	part->first = pos;
+	part->next = pos;
+	while (pos < part->end) {
+		if (__atomic_load_n(&idx->stop, __ATOMIC_RELAXED))
+			return;
+		if (read_index_desc(part, pos, &dp) != KDUMP_OK)
+			return;
+		if (dp.dp_flags & DUMP_END) {
+			part->at_end = true;
+			return;
+		}
+		if (add_index_ent(part, dp.dp_address >> idx->page_shift,
+				  pos) != KDUMP_OK)
+			return;
+
+		pos += sizeof dp + dp.dp_size;
+		part->next = pos;
+		if (merge && part->nent >= INDEX_BATCH &&
+		    !merge_index_ents(part))
+			return;
+	}
+	part->done = true;
+}
+
+/**  Free the scanning data of a file part.
+ * @param part  File part.
+ */
+static void
+free_index_part(struct index_part *part)
+{
+	if (part->running) {
+		thread_join(part->thread, NULL);
+		part->running = false;
+	}
+	free(part->buf);
+	part->buf = NULL;
+	free(part->ent);
+	part->ent = NULL;
+	part->nent = part->allocent = 0;
+}
+
+/**  Indexer thread for a part other than the first one.
+ * @param arg  File part.
+ * @returns    Always @c NULL.
+ */
+static void *
+index_part_thread(void *arg)
+{
+	struct index_part *part = arg;
+	off_t pos;
+
+	if (find_first_desc(part, &pos) == KDUMP_OK)
+		scan_index_part(part, pos, 0);
+	free(part->buf);
+	part->buf = NULL;
+	return NULL;
+}
+
+/**  Main background indexer thread.
+ * @param arg  Indexer.
+ * @returns    Always @c NULL.
+ *
+ * This thread scans the first part itself and merges the results of
+ * the other parts in file order. If a part could not be scanned, or
+ * the scan started at a wrong position, it is scanned again from the
+ * position where the preceding part ended. When the indexer stops,
+ * readers continue from @c last_offset as if there was no indexer.
+ */
+static void *
+indexer_thread(void *arg)
+{
+	struct lkcd_indexer *idx = arg;
+	struct lkcd_priv *lkcdp = idx->lkcdp;
+	struct index_part *part;
+	off_t pos;
+	unsigned i;
+
+	for (i = 1; i < idx->nparts; ++i) {
+		part = &idx->part[i];
+		part->running = !thread_create(&part->thread,
+					       index_part_thread, part);
+	}
+
+	pos = idx->part[0].start;
+	for (i = 0; i < idx->nparts; ++i) {
+		part = &idx->part[i];
+		if (part->running) {
+			thread_join(part->thread, NULL);
+			part->running = false;
+		}
+		if (part->first != pos) {
+			part->nent = 0;
+			part->done = part->at_end = false;
+			scan_index_part(part, pos, 1);
+		}
+		if (!merge_index_ents(part) || !part->done)
+			break;
+		free_index_part(part);
+		pos = part->next;
+	}
+
+	__atomic_store_n(&idx->stop, true, __ATOMIC_RELAXED);
+	for (i = 0; i < idx->nparts; ++i)
+		free_index_part(&idx->part[i]);
+
+	mutex_lock(&lkcdp->pfn_block_mutex);
+	end_page_descs(&idx->add);
+	lkcdp->indexing = false;
+	cond_broadcast(&lkcdp->pfn_block_cond);
+	mutex_unlock(&lkcdp->pfn_block_mutex);
+
+	return NULL;
+}
+
+/**  Free a background indexer.
+ * @param idx  Indexer.
+ *
+ * The indexer thread must not be running.
+ */
+static void
+free_indexer(struct lkcd_indexer *idx)
+{
+	fcache_decref(idx->fcache);
+	err_cleanup(idx->err);
+	free(idx->err);
+	free(idx);
+}
+
+/**  Start building the PFN tables in the background.
+ * @param ctx       Dump file object.
+ * @param nthreads  Maximum number of indexer threads.
+ * @returns         Error status.
+ *
+ * If the indexer thread cannot be started, the PFN tables are built
+ * before this function returns.
+ */
+static kdump_status
+start_indexer(kdump_ctx_t *ctx, unsigned nthreads)
+{
+	struct lkcd_priv *lkcdp = ctx->shared->fmtdata;
+	struct fcache *fc = ctx->shared->fcache;
+	struct lkcd_indexer *idx;
+	struct index_part *part;
+	unsigned nparts, i;
+	off_t size, partsz;
+
+	size = fc->filesz - lkcdp->last_offset;
+	if (size <= 0)
+		return KDUMP_OK;
+
+	if (nthreads > INDEX_MAX_THREADS)
+		nthreads = INDEX_MAX_THREADS;
+	nparts = size / INDEX_PART_MIN < nthreads
+		? size / INDEX_PART_MIN
+		: nthreads;
+	if (!nparts)
+		nparts = 1;
+	partsz = size / nparts;
+
+	idx = calloc(1, sizeof *idx + nparts * sizeof *idx->part);
+	if (!idx)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate LKCD indexer");
+	idx->err = malloc(sizeof(kdump_errmsg_t) + INDEX_ERRBUF);
+	if (!idx->err) {
+		free(idx);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate LKCD indexer");
+	}
+	err_init(idx->err, INDEX_ERRBUF);
+
+	idx->lkcdp = lkcdp;
+	idx->fcache = fc;
+	fcache_incref(fc);
+	idx->page_shift = get_page_shift(ctx);
+	idx->byte_order = get_byte_order(ctx);
+	init_pfn_adder(&idx->add, lkcdp, idx->err);
+
+	idx->nparts = nparts;
+	for (i = 0; i < nparts; ++i) {
+		part = &idx->part[i];
+		part->idx = idx;
+		part->start = lkcdp->last_offset + i * partsz;
+		part->end = (i < nparts - 1)
+			? part->start + partsz
+			: fc->filesz;
+		part->first = -1;
+	}
+
+	lkcdp->indexing = true;
+	if (thread_create(&idx->thread, indexer_thread, idx)) {
+		indexer_thread(idx);
+		free_indexer(idx);
+		return KDUMP_OK;
+	}
+
+	lkcdp->indexer = idx;
 	return KDUMP_OK;
 }
 
+/**  Stop the background indexer.
+ * @param lkcdp  LKCD private data.
+ */
+static void
+stop_indexer(struct lkcd_priv *lkcdp)
+{
+	struct lkcd_indexer *idx = lkcdp->indexer;
+
+	if (!idx)
+		return;
+
+	__atomic_store_n(&idx->stop, true, __ATOMIC_RELAXED);
+	thread_join(idx->thread, NULL);
+	free_indexer(idx);
+	lkcdp->indexer = NULL;
+}
+
 static inline int
 idx_is_gap(struct pfn_block *block, unsigned idx)
 {
@@ -675,16 +1250,24 @@ get_page_desc(kdump_ctx_t *ctx, kdump_pfn_t pfn,
 
 	mutex_lock(&lkcdp->pfn_block_mutex);
 
-	block = lookup_pfn_block(ctx, pfn, 0);
-	idx = pfn_idx3(pfn);
-	if (block && !idx_is_gap(block, idx)) {
-		off_t off = block->filepos;
-		if (idx > block->idx3)
-			off += block->offs[idx - block->idx3 - 1];
-		*dataoff = off + sizeof *dp;
-		status = read_page_desc(ctx, dp, off);
-	} else
-		status = search_page_desc(ctx, pfn, dp, dataoff);
+	for (;;) {
+		block = lookup_pfn_block(lkcdp, pfn, 0);
+		idx = pfn_idx3(pfn);
+		if (block && !idx_is_gap(block, idx)) {
+			off_t off = block->filepos;
+			if (idx > block->idx3)
+				off += block->offs[idx - block->idx3 - 1];
+			*dataoff = off + sizeof *dp;
+			status = read_page_desc(ctx, dp, off);
+			break;
+		}
+		if (!lkcdp->indexing) {
+			status = search_page_desc(ctx, pfn, dp, dataoff);
+			break;
+		}
+		/* Wait until the background indexer adds more pages. */
+		cond_wait(&lkcdp->pfn_block_cond, &lkcdp->pfn_block_mutex);
+	}
 
 	mutex_unlock(&lkcdp->pfn_block_mutex);
 
@@ -701,14 +1284,15 @@ lkcd_max_pfn_revalidate(kdump_ctx_t *ctx, struct attr_data *attr)
 
 	mutex_lock(&lkcdp->pfn_block_mutex);
 
+	while (lkcdp->indexing)
+		cond_wait(&lkcdp->pfn_block_cond, &lkcdp->pfn_block_mutex);
+
 	if (lkcdp->last_offset != lkcdp->end_offset) {
 		struct dump_page dummy_dp;
 		off_t dummy_off;
 
-		mutex_lock(&ctx->shared->cache_lock);
 		res = search_page_desc(ctx, ~(kdump_pfn_t)0,
 				       &dummy_dp, &dummy_off);
-		mutex_unlock(&ctx->shared->cache_lock);
 		if (res == KDUMP_ERR_NODATA) {
 			clear_error(ctx);
 			res = KDUMP_OK;
@@ -746,11 +1330,9 @@ lkcd_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 	void *buf;
 	kdump_status ret;
 
-	mutex_lock(&ctx->shared->cache_lock);
 	off = 0;
 	pfn = pio->addr.addr >> get_page_shift(ctx);
 	ret = get_page_desc(ctx, pfn, &dp, &off);
-	mutex_unlock(&ctx->shared->cache_lock);
 	if (ret != KDUMP_OK)
 		return ret;
 
@@ -776,9 +1358,7 @@ lkcd_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 	}
 
 	/* read page data */
-	mutex_lock(&ctx->shared->cache_lock);
 	ret = fcache_pread(ctx->shared->fcache, buf, dp.dp_size, off);
-	mutex_unlock(&ctx->shared->cache_lock);
 	if (ret != KDUMP_OK)
 		return set_error(ctx, ret,
 				 "Cannot read page data at %llu",
@@ -798,7 +1378,8 @@ lkcd_read_page(kdump_ctx_t *ctx, struct page_io *pio)
 					 "Wrong uncompressed size: %lu",
 					 (unsigned long) retlen);
 	} else if (lkcdp->compression == DUMP_COMPRESS_GZIP) {
-		ret = uncompress_page_gzip(ctx, pio->chunk.data, buf, dp.dp_size);
+		ret = uncompress_page_gzip(ctx, lkcdp->zlib_slot,
+					   pio->chunk.data, buf, dp.dp_size);
 		if (ret != KDUMP_OK)
 			return ret;
 	} else
@@ -831,7 +1412,8 @@ lkcd_realloc_compressed(kdump_ctx_t *ctx, struct attr_data *attr)
 	struct lkcd_priv *lkcdp;
 	int newslot;
 
-	newslot = per_ctx_alloc(ctx->shared, attr_value(attr)->number);
+	newslot = per_ctx_alloc(ctx->shared, attr_value(attr)->number,
+				NULL);
 	if (newslot < 0)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate buffer for compressed data");
@@ -915,6 +1497,7 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 {
 	struct dump_header_common *dh = hdr;
 	struct lkcd_priv *lkcdp;
+	struct attr_data *attr;
 	kdump_status ret;
 
 	lkcdp = ctx_malloc(sizeof *lkcdp, ctx, "LKCD private data");
@@ -937,13 +1520,22 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot initialize LKCD data mutex");
 	}
+	if (cond_init(&lkcdp->pfn_block_cond, NULL)) {
+		mutex_destroy(&lkcdp->pfn_block_mutex);
+		free(lkcdp);
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot initialize LKCD data condition");
+	}
 	lkcdp->pfn_level1 = NULL;
 	lkcdp->l1_size = 0;
+	lkcdp->indexer = NULL;
+	lkcdp->indexing = false;
 
 	attr_add_override(gattr(ctx, GKI_page_size),
 			  &lkcdp->page_size_override);
 	lkcdp->page_size_override.ops.post_set = lkcd_realloc_compressed;
 	lkcdp->cbuf_slot = -1;
+	lkcdp->zlib_slot = -1;
 
 	ret = set_page_size(ctx, dump32toh(ctx, dh->dh_page_size));
 	if (ret != KDUMP_OK)
@@ -984,6 +1576,24 @@ open_common(kdump_ctx_t *ctx, void *hdr)
 	if (ret != KDUMP_OK)
 		goto err_free;
 
+#if USE_ZLIB || USE_LIBDEFLATE
+	if (lkcdp->compression == DUMP_COMPRESS_GZIP) {
+		lkcdp->zlib_slot = gzip_slot_alloc(ctx->shared);
+		if (lkcdp->zlib_slot < 0) {
+			ret = set_error(ctx, KDUMP_ERR_SYSTEM,
+					"Cannot allocate zlib state slot");
+			goto err_free;
+		}
+	}
+#endif
+
+	attr = gattr(ctx, GKI_file_index_threads);
+	if (attr_isset(attr) && attr_value(attr)->number) {
+		ret = start_indexer(ctx, attr_value(attr)->number);
+		if (ret != KDUMP_OK)
+			goto err_free;
+	}
+
 	return KDUMP_OK;
 
   err_free:
@@ -1065,10 +1675,14 @@ lkcd_cleanup(struct kdump_shared *shared)
 {
 	struct lkcd_priv *lkcdp = shared->fmtdata;
 
+	stop_indexer(lkcdp);
 	free_level1(lkcdp->pfn_level1, lkcdp->l1_size);
+	cond_destroy(&lkcdp->pfn_block_cond);
 	mutex_destroy(&lkcdp->pfn_block_mutex);
 	if (lkcdp->cbuf_slot >= 0)
 		per_ctx_free(shared, lkcdp->cbuf_slot);
+	if (lkcdp->zlib_slot >= 0)
+		per_ctx_free(shared, lkcdp->zlib_slot);
 	free(lkcdp);
 	shared->fmtdata = NULL;
 }
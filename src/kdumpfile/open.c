@@ -36,26 +36,6 @@
 #include <string.h>
 #include <unistd.h>
 
-/** File cache size.
- * This number should be big enough to cover page table lookups with a
- * scattered page table hierarchy, including a possible Xen mtop lookup
- * in a separate hierarchy. The worst case seems to be 4-level paging with
- * a subsequent lookup (4-level paging again, plus the lookup page) and
- * a data page. That is 4 + 1 + 4 + 1 = 10. Let's add some reserve and use
- * a beautirul power of two.
- */
-#define FCACHE_SIZE	16
-
-/** File cache page order.
- * This number should be high enough to leverage transparent huge pages in
- * the kernel (if possible), but small enough not to exhaust the virtual
- * address space (especially on 32-bit platforms).
- * Choosing 10 here results in 4M blocks on architectures with 4K pages
- * and 64M blocks on architectures with 64K pages. In the latter case,
- * virtual address space may a bit tight on a 32-bit platform.
- */
-#define FCACHE_ORDER	10
-
 static kdump_status kdump_open_known(kdump_ctx_t *pctx);
 
 static const struct format_ops *formats[] = {
@@ -118,6 +98,12 @@ file_fd_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
 
 	ctx->xlat->dirty = true;
 
+	ret = flattened_open(ctx);
+	if (ret == KDUMP_NOPROBE)
+		clear_error(ctx);
+	else if (ret != KDUMP_OK)
+		return ret;
+
 	for (i = 0; i < ARRAY_SIZE(formats); ++i) {
 		ctx->shared->ops = formats[i];
 		ret = ctx->shared->ops->probe(ctx);
@@ -151,6 +137,35 @@ const struct attr_ops file_fd_ops = {
 	.post_set = file_fd_post_hook,
 };
 
+kdump_status
+kdump_open_fdset(kdump_ctx_t *ctx, unsigned nfds, const int *fds)
+{
+	struct kdump_shared *shared = ctx->shared;
+	kdump_status ret;
+
+	clear_error(ctx);
+	if (!nfds)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Empty file descriptor set");
+
+	rwlock_wrlock(&shared->lock);
+
+	/* Format handlers which support split dumps reset the count. */
+	shared->split_fds = fds + 1;
+	shared->nsplit_fds = nfds - 1;
+	ret = set_attr_number(ctx, gattr(ctx, GKI_file_fd),
+			      ATTR_PERSIST, fds[0]);
+	if (ret == KDUMP_OK && shared->nsplit_fds)
+		ret = set_error(ctx, KDUMP_ERR_NOTIMPL,
+				"%s files cannot be split",
+				shared->ops->name);
+	shared->split_fds = NULL;
+	shared->nsplit_fds = 0;
+
+	rwlock_unlock(&shared->lock);
+	return ret;
+}
+
 /* struct new_utsname is inside struct uts_namespace, preceded by a struct
  * kref, but the offset is not stored in VMCOREINFO. So, search some sane
  * amount of memory for UTS_SYSNAME, which can be used as kind of a magic
@@ -330,11 +345,13 @@ kdump_free(kdump_ctx_t *ctx)
 	struct kdump_shared *shared = ctx->shared;
 	int slot;
 
+	readahead_free(ctx);
+
 	rwlock_wrlock(&shared->lock);
 
 	for (slot = 0; slot < PER_CTX_SLOTS; ++slot)
 		if (shared->per_ctx_size[slot])
-			free(ctx->data[slot]);
+			per_ctx_release(shared, slot, ctx->data[slot]);
 
 	addrxlat_ctx_decref(ctx->xlatctx);
 
@@ -34,6 +34,8 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <sys/mman.h>
 
 /** Get a page from the default cache.
  *
@@ -43,23 +45,34 @@
  * @returns    Error status.
  *
  * If the page is not currently found in the cache, read it using
- * the read function.
+ * the read function. The read function is called without holding
+ * any lock, so it can do blocking I/O without stalling other threads.
+ *
+ * If @c pio->buf is set, an uncached page is read directly into that
+ * buffer, and no cache entry is allocated for it.
  */
 kdump_status
 cache_get_page(kdump_ctx_t *ctx, struct page_io *pio, read_page_fn *fn)
 {
 	struct cache_entry *entry;
+	cache_key_t key = pio->addr.addr | pio->addr.as;
 	kdump_status ret;
 
-	mutex_lock(&ctx->shared->cache_lock);
 	pio->chunk.nent = 1;
 	pio->chunk.embed_fces->cache = ctx->shared->cache;
-	entry = cache_get_entry(pio->chunk.embed_fces->cache,
-				pio->addr.addr | pio->addr.as);
-	mutex_unlock(&ctx->shared->cache_lock);
-	if (!entry)
-		return set_error(ctx, KDUMP_ERR_BUSY,
-				 "Cache is fully utilized");
+	if (pio->buf) {
+		entry = cache_lookup_entry(pio->chunk.embed_fces->cache, key);
+		if (!entry) {
+			pio->chunk.nent = 0;
+			pio->chunk.data = pio->buf;
+			return fn(ctx, pio);
+		}
+	} else {
+		entry = cache_get_entry(pio->chunk.embed_fces->cache, key);
+		if (!entry)
+			return set_error(ctx, KDUMP_ERR_BUSY,
+					 "Cache is fully utilized");
+	}
 
 	pio->chunk.data = entry->data;
 	pio->chunk.embed_fces->ce = entry;
@@ -67,15 +80,55 @@ cache_get_page(kdump_ctx_t *ctx, struct page_io *pio, read_page_fn *fn)
 		return KDUMP_OK;
 
 	ret = fn(ctx, pio);
-	mutex_lock(&ctx->shared->cache_lock);
 	if (ret == KDUMP_OK)
 		cache_insert(pio->chunk.embed_fces->cache, entry);
 	else
 		cache_discard(pio->chunk.embed_fces->cache, entry);
-	mutex_unlock(&ctx->shared->cache_lock);
 	return ret;
 }
 
+/**  Get the shared zero page.
+ * @param ctx  Dump file object.
+ * @param pio  Page I/O control.
+ * @returns    Error status.
+ *
+ * Use this function for pages which are known to contain only zeroes,
+ * e.g. excluded pages. The same read-only page is returned for all
+ * addresses, and it does not use any cache entry. It must be released
+ * with @ref cache_put_page.
+ */
+kdump_status
+get_zero_page(kdump_ctx_t *ctx, struct page_io *pio)
+{
+	struct kdump_shared *shared = ctx->shared;
+	void *page, *expect;
+
+	page = __atomic_load_n(&shared->zero_page, __ATOMIC_ACQUIRE);
+	if (!page) {
+		/* Anonymous read-only pages all map the kernel's zero page,
+		 * so this does not take up any memory. */
+		page = mmap(NULL, MAX_PAGE_SIZE, PROT_READ,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (page == MAP_FAILED)
+			return set_error(ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot map zero page: %s",
+					 strerror(errno));
+		expect = NULL;
+		if (!__atomic_compare_exchange_n(&shared->zero_page,
+						 &expect, page, false,
+						 __ATOMIC_ACQ_REL,
+						 __ATOMIC_ACQUIRE)) {
+			munmap(page, MAX_PAGE_SIZE);
+			page = expect;
+		}
+	}
+
+	pio->chunk.data = page;
+	pio->chunk.nent = 0;
+	__atomic_fetch_add(&shared->zero_pages.number, 1, __ATOMIC_RELAXED);
+	return KDUMP_OK;
+}
+
 /**  Drop a reference to an I/O page from the default cache.
  * @param ctx  Dump file object.
  * @param pio  Page I/O control.
@@ -83,7 +136,11 @@ cache_get_page(kdump_ctx_t *ctx, struct page_io *pio, read_page_fn *fn)
 void
 cache_put_page(kdump_ctx_t *ctx, struct page_io *pio)
 {
-	fcache_put_chunk(&pio->chunk);
+	/* A chunk without cache entries owns a malloc'ed buffer, which
+	 * fcache_put_chunk frees. The zero page has no cache entries
+	 * either, but it is shared and mapped, so skip it. */
+	if (pio->chunk.data != ctx->shared->zero_page)
+		fcache_put_chunk(&pio->chunk);
 }
 
 static addrxlat_status
@@ -113,6 +170,9 @@ get_page_xlat(kdump_ctx_t *ctx, struct page_io *pio)
 	if (status != KDUMP_OK)
 		return status;
 
+	if (pio->addr.as == ADDRXLAT_KVADDR)
+		tlb_translate(ctx, &pio->addr);
+
 	ctl.ctx = ctx->xlatctx;
 	ctl.sys = ctx->xlat->xlatsys;
 	ctl.op = xlat_pio_op;
@@ -139,22 +199,279 @@ get_page_maybe_xlat(kdump_ctx_t *ctx, struct page_io *pio)
 		: get_page_xlat(ctx, pio);
 }
 
-/**  Internal version of @ref kdump_read
+/** Number of sequential pages needed to start readahead. */
+#define READAHEAD_MIN_RUN	2
+
+/**  Readahead thread state.
+ */
+struct readahead {
+	/** Private clone of the reading context. */
+	kdump_ctx_t *ctx;
+
+	/** Protects the fields below.
+	 * The thread checks @c stop and @c count without the lock while
+	 * it reads pages, so they are always written atomically.
+	 */
+	mutex_t lock;
+	cond_t cond;		/**< Signalled when there is a new request. */
+	thread_t thread;	/**< Readahead thread. */
+	bool stop;		/**< Request to terminate the thread. */
+
+	kdump_addrspace_t as;	/**< Address space of the request. */
+	kdump_addr_t addr;	/**< First page of the request. */
+	unsigned long count;	/**< Number of pages, zero if idle. */
+};
+
+/**  Read a page into the cache.
+ * @param ctx   Dump file object.
+ * @param as    Address space.
+ * @param addr  Page address.
+ *
+ * Errors are ignored, and the error message is cleared, because no one
+ * asked for this page. In particular, pages excluded from a filtered
+ * dump must not stop readahead of the following pages.
+ *
+ * The shared lock must be held by the caller.
+ */
+static void
+prefetch_page(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr)
+{
+	struct page_io pio;
+
+	pio.addr.as = (addrxlat_addrspace_t) as;
+	pio.addr.addr = addr;
+	pio.buf = NULL;
+	if (get_page_maybe_xlat(ctx, &pio) == KDUMP_OK)
+		put_page(ctx, &pio);
+	clear_error(ctx);
+}
+
+/**  Readahead thread.
+ * @param arg  Readahead thread state.
+ * @returns    Always @c NULL.
+ */
+static void *
+readahead_thread(void *arg)
+{
+	struct readahead *ra = arg;
+	kdump_addrspace_t as;
+	kdump_addr_t addr;
+	unsigned long count;
+
+	mutex_lock(&ra->lock);
+	while (!ra->stop) {
+		if (!ra->count) {
+			cond_wait(&ra->cond, &ra->lock);
+			continue;
+		}
+
+		as = ra->as;
+		addr = ra->addr;
+		count = ra->count;
+		__atomic_store_n(&ra->count, 0, __ATOMIC_RELAXED);
+		mutex_unlock(&ra->lock);
+
+		/* Take the shared lock for each page separately, so that
+		 * writers are not blocked by a long readahead. Stop early
+		 * if there is a new request, but not if a page fails. */
+		while (count-- &&
+		       !__atomic_load_n(&ra->stop, __ATOMIC_RELAXED) &&
+		       !__atomic_load_n(&ra->count, __ATOMIC_RELAXED)) {
+			rwlock_rdlock(&ra->ctx->shared->lock);
+			prefetch_page(ra->ctx, as, addr);
+			rwlock_unlock(&ra->ctx->shared->lock);
+			addr += get_page_size(ra->ctx);
+		}
+
+		mutex_lock(&ra->lock);
+	}
+	mutex_unlock(&ra->lock);
+
+	return NULL;
+}
+
+/**  Post the pending readahead request to the readahead thread.
+ * @param ctx  Dump file object.
+ */
+static void
+readahead_post(kdump_ctx_t *ctx)
+{
+	struct readahead *ra = ctx->ra;
+
+	mutex_lock(&ra->lock);
+	ra->as = ctx->stream.as;
+	ra->addr = ctx->stream.req_addr;
+	__atomic_store_n(&ra->count, ctx->stream.req_count, __ATOMIC_RELAXED);
+	cond_broadcast(&ra->cond);
+	mutex_unlock(&ra->lock);
+}
+
+/**  Start the readahead thread and post the pending request.
+ * @param ctx  Dump file object.
+ *
+ * The readahead thread needs its own clone of @p ctx, so this function
+ * must be called without holding the shared lock. If the thread cannot
+ * be started, readahead is done synchronously from now on.
+ */
+static void
+readahead_start(kdump_ctx_t *ctx)
+{
+	struct readahead *ra;
+
+	ctx->stream.pending = false;
+
+	ra = calloc(1, sizeof *ra);
+	if (!ra)
+		goto err;
+
+	ra->ctx = kdump_clone(ctx, 0);
+	if (!ra->ctx)
+		goto err_free;
+	if (mutex_init(&ra->lock, NULL))
+		goto err_clone;
+	if (cond_init(&ra->cond, NULL))
+		goto err_mutex;
+
+	ra->as = ctx->stream.as;
+	ra->addr = ctx->stream.req_addr;
+	ra->count = ctx->stream.req_count;
+	if (thread_create(&ra->thread, readahead_thread, ra))
+		goto err_cond;
+
+	ctx->ra = ra;
+	return;
+
+ err_cond:
+	cond_destroy(&ra->cond);
+ err_mutex:
+	mutex_destroy(&ra->lock);
+ err_clone:
+	kdump_free(ra->ctx);
+ err_free:
+	free(ra);
+ err:
+	ctx->stream.sync = true;
+}
+
+/**  Stop the readahead thread.
+ * @param ctx  Dump file object.
+ *
+ * This function must be called without holding the shared lock.
+ */
+void
+readahead_free(kdump_ctx_t *ctx)
+{
+	struct readahead *ra = ctx->ra;
+
+	if (!ra)
+		return;
+
+	mutex_lock(&ra->lock);
+	__atomic_store_n(&ra->stop, true, __ATOMIC_RELAXED);
+	cond_broadcast(&ra->cond);
+	mutex_unlock(&ra->lock);
+	thread_join(ra->thread, NULL);
+
+	cond_destroy(&ra->cond);
+	mutex_destroy(&ra->lock);
+	kdump_free(ra->ctx);
+	free(ra);
+	ctx->ra = NULL;
+}
+
+/**  Get the effective readahead window.
+ * @param ctx  Dump file object.
+ * @returns    Number of pages to read ahead, zero if disabled.
+ */
+static unsigned long
+readahead_window(kdump_ctx_t *ctx)
+{
+	unsigned long window, limit;
+
+	if (!attr_value(gattr(ctx, GKI_cache_readahead))->number)
+		return 0;
+
+	window = attr_value(gattr(ctx, GKI_cache_readahead_window))->number;
+	limit = get_cache_size(ctx) / 2;
+	return window < limit ? window : limit;
+}
+
+/**  Update sequential read detection with a new page.
+ * @param ctx   Dump file object.
+ * @param as    Address space.
+ * @param addr  Page address.
+ *
+ * If the access is sequential and the readahead window is more than
+ * half consumed, request the following pages. The request is posted to
+ * the readahead thread if it is already running. Otherwise, it is left
+ * pending for @ref kdump_read, or the pages are read synchronously if
+ * background readahead is not available.
+ */
+static void
+stream_advance(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr)
+{
+	struct read_stream *s = &ctx->stream;
+	size_t pagesz = get_page_size(ctx);
+	unsigned long window;
+	kdump_addr_t end;
+
+	if (s->as == as && s->next == addr + pagesz)
+		return;		/* same page again */
+
+	if (s->as == as && s->next == addr) {
+		++s->run;
+	} else {
+		s->as = as;
+		s->run = 0;
+		s->ahead = 0;
+	}
+	s->next = addr + pagesz;
+
+	if (s->run < READAHEAD_MIN_RUN || s->pending)
+		return;
+	window = readahead_window(ctx);
+	if (!window)
+		return;
+
+	if (s->ahead < s->next)
+		s->ahead = s->next;
+	if (s->ahead - s->next > (window / 2) * pagesz)
+		return;
+	end = s->next + window * pagesz;
+	if (end <= s->ahead)
+		return;		/* address space wrap-around */
+
+	s->req_addr = s->ahead;
+	s->req_count = (end - s->ahead) / pagesz;
+	s->ahead = end;
+
+	if (ctx->ra)
+		readahead_post(ctx);
+	else if (s->sync) {
+		for (addr = s->req_addr; addr < end; addr += pagesz)
+			prefetch_page(ctx, as, addr);
+	} else
+		s->pending = true;
+}
+
+/**  Read data with flags.
  * @param         ctx      Dump file object.
  * @param[in]     as       Address space of @p addr.
  * @param[in]     addr     Any type of address.
  * @param[out]    buffer   Buffer to receive data.
  * @param[in,out] plength  Length of the buffer.
+ * @param[in]     flags    Read flags (@c KDUMP_READ_xxx).
  * @returns                Error status.
  *
- * Use this function internally if the shared lock is already held
- * (for reading or writing).
+ * The shared lock must be held by the caller.
  *
- * @sa kdump_read
+ * For streaming reads, whole pages which are not cached are read
+ * directly into @p buffer. Streaming reads do not trigger readahead,
+ * because that would also fill the cache.
  */
-kdump_status
-read_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
-	    void *buffer, size_t *plength)
+static kdump_status
+read_flags_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
+		  void *buffer, size_t *plength, unsigned long flags)
 {
 	struct page_io pio;
 	size_t remain;
@@ -165,18 +482,30 @@ read_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	while (remain) {
 		size_t off, partlen;
 
-		pio.addr.as = as;
+		off = addr % get_page_size(ctx);
+		partlen = get_page_size(ctx) - off;
+		if (partlen > remain)
+			partlen = remain;
+
+		pio.addr.as = (addrxlat_addrspace_t) as;
 		pio.addr.addr = page_align(ctx, addr);
+		pio.buf = (flags & KDUMP_READ_STREAM) && !off &&
+			partlen == get_page_size(ctx)
+			? buffer
+			: NULL;
 		ret = get_page_maybe_xlat(ctx, &pio);
 		if (ret != KDUMP_OK)
 			break;
 
-		off = addr % get_page_size(ctx);
-		partlen = get_page_size(ctx) - off;
-		if (partlen > remain)
-			partlen = remain;
-		memcpy(buffer, pio.chunk.data + off, partlen);
-		put_page(ctx, &pio);
+		if (pio.chunk.data != buffer) {
+			memcpy(buffer, pio.chunk.data + off, partlen);
+			put_page(ctx, &pio);
+		}
+
+		/* Synchronous readahead needs cache entries, so it must
+		 * not run while the current page is still held. */
+		if (!(flags & KDUMP_READ_STREAM))
+			stream_advance(ctx, as, page_align(ctx, addr));
 		addr += partlen;
 		buffer += partlen;
 		remain -= partlen;
@@ -186,16 +515,215 @@ read_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	return ret;
 }
 
+/**  Internal version of @ref kdump_read
+ * @param         ctx      Dump file object.
+ * @param[in]     as       Address space of @p addr.
+ * @param[in]     addr     Any type of address.
+ * @param[out]    buffer   Buffer to receive data.
+ * @param[in,out] plength  Length of the buffer.
+ * @returns                Error status.
+ *
+ * Use this function internally if the shared lock is already held
+ * (for reading or writing).
+ *
+ * @sa kdump_read
+ */
+kdump_status
+read_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
+	    void *buffer, size_t *plength)
+{
+	return read_flags_locked(ctx, as, addr, buffer, plength, 0);
+}
+
 kdump_status
 kdump_read(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	    void *buffer, size_t *plength)
 {
+	return kdump_read_flags(ctx, as, addr, buffer, plength, 0);
+}
+
+kdump_status
+kdump_read_flags(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
+		 void *buffer, size_t *plength, unsigned long flags)
+{
+	kdump_status ret;
+
+	clear_error(ctx);
+	rwlock_rdlock(&ctx->shared->lock);
+	ret = read_flags_locked(ctx, as, addr, buffer, plength, flags);
+	rwlock_unlock(&ctx->shared->lock);
+
+	if (ctx->stream.pending)
+		readahead_start(ctx);
+	return ret;
+}
+
+kdump_status
+kdump_get_page(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
+	       kdump_page_t *page)
+{
+	struct page_io *pio;
+	kdump_status ret;
+
+	clear_error(ctx);
+
+	pio = malloc(sizeof *pio);
+	if (!pio)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate pio structure");
+
+	rwlock_rdlock(&ctx->shared->lock);
+	pio->addr.as = (addrxlat_addrspace_t) as;
+	pio->addr.addr = page_align(ctx, addr);
+	pio->buf = NULL;
+	ret = get_page_maybe_xlat(ctx, pio);
+	if (ret == KDUMP_OK) {
+		page->addr = page_align(ctx, addr);
+		page->data = pio->chunk.data;
+		page->size = get_page_size(ctx);
+		page->priv = pio;
+	} else
+		free(pio);
+	rwlock_unlock(&ctx->shared->lock);
+
+	return ret;
+}
+
+void
+kdump_put_page(kdump_ctx_t *ctx, kdump_page_t *page)
+{
+	struct page_io *pio = page->priv;
+
+	rwlock_rdlock(&ctx->shared->lock);
+	put_page(ctx, pio);
+	rwlock_unlock(&ctx->shared->lock);
+	free(pio);
+}
+
+/**  Compare two vectored read requests by address.
+ * @param a  Pointer to the first request pointer.
+ * @param b  Pointer to the second request pointer.
+ * @returns  Negative, zero or positive, as required by qsort(3).
+ */
+static int
+iovec_cmp(const void *a, const void *b)
+{
+	const kdump_iovec_t *va = *(const kdump_iovec_t *const *)a;
+	const kdump_iovec_t *vb = *(const kdump_iovec_t *const *)b;
+	return (va->addr > vb->addr) - (va->addr < vb->addr);
+}
+
+/**  Internal version of @ref kdump_readv
+ * @param         ctx    Dump file object.
+ * @param[in]     as     Address space of all requests.
+ * @param[in,out] order  Pointers to requests, sorted by address.
+ * @param[in]     n      Number of requests.
+ * @returns              Status of the failed request with the lowest
+ *                       address, or @ref KDUMP_OK.
+ *
+ * The last page is kept referenced until a request needs a different
+ * page, so consecutive requests from the same page share a single
+ * lookup. If the lookup fails, the status is remembered for the
+ * remaining requests from the same page.
+ *
+ * Only the error string of the first failed lookup is kept, so that
+ * many failures do not produce an inordinately long error message.
+ *
+ * Use this function internally if the shared lock is already held
+ * (for reading or writing).
+ */
+static kdump_status
+readv_locked(kdump_ctx_t *ctx, kdump_addrspace_t as,
+	     kdump_iovec_t *const *order, size_t n)
+{
+	struct page_io pio;
+	kdump_addr_t pageaddr = 0;
+	kdump_status pagestatus = KDUMP_OK;
+	kdump_status firststatus = KDUMP_OK;
+	char *firsterr = NULL;
+	int lookedup = 0;
+	size_t i;
+
+	for (i = 0; i < n; ++i) {
+		kdump_iovec_t *v = order[i];
+		kdump_addr_t addr = v->addr;
+		void *buffer = v->buf;
+		size_t remain = v->len;
+
+		v->status = KDUMP_OK;
+		while (remain) {
+			size_t off, partlen;
+
+			if (!lookedup || page_align(ctx, addr) != pageaddr) {
+				if (lookedup && pagestatus == KDUMP_OK)
+					put_page(ctx, &pio);
+				clear_error(ctx);
+				pageaddr = page_align(ctx, addr);
+				pio.addr.as = (addrxlat_addrspace_t) as;
+				pio.addr.addr = pageaddr;
+				pio.buf = NULL;
+				pagestatus = get_page_maybe_xlat(ctx, &pio);
+				lookedup = 1;
+				if (pagestatus != KDUMP_OK &&
+				    firststatus == KDUMP_OK) {
+					firststatus = pagestatus;
+					firsterr = strdup(err_str(&ctx->err));
+				}
+			}
+			if (pagestatus != KDUMP_OK) {
+				v->status = pagestatus;
+				break;
+			}
+
+			off = addr - pageaddr;
+			partlen = get_page_size(ctx) - off;
+			if (partlen > remain)
+				partlen = remain;
+			memcpy(buffer, pio.chunk.data + off, partlen);
+			addr += partlen;
+			buffer += partlen;
+			remain -= partlen;
+		}
+		v->len -= remain;
+	}
+
+	if (lookedup && pagestatus == KDUMP_OK)
+		put_page(ctx, &pio);
+
+	clear_error(ctx);
+	if (firststatus != KDUMP_OK) {
+		if (firsterr)
+			set_error(ctx, firststatus, "%s", firsterr);
+		else
+			set_error(ctx, firststatus, "Vectored read failed");
+		free(firsterr);
+	}
+	return firststatus;
+}
+
+kdump_status
+kdump_readv(kdump_ctx_t *ctx, kdump_addrspace_t as,
+	    kdump_iovec_t *vec, size_t n)
+{
+	kdump_iovec_t **order;
 	kdump_status ret;
+	size_t i;
 
 	clear_error(ctx);
+
+	order = malloc(n * sizeof *order);
+	if (!order && n)
+		return set_error(ctx, KDUMP_ERR_SYSTEM,
+				 "Cannot allocate %zu read requests", n);
+	for (i = 0; i < n; ++i)
+		order[i] = &vec[i];
+	qsort(order, n, sizeof *order, iovec_cmp);
+
 	rwlock_rdlock(&ctx->shared->lock);
-	ret = read_locked(ctx, as, addr, buffer, plength);
+	ret = readv_locked(ctx, as, order, n);
 	rwlock_unlock(&ctx->shared->lock);
+
+	free(order);
 	return ret;
 }
 
@@ -223,8 +751,9 @@ read_string_locked(kdump_ctx_t *ctx, kdump_addrspace_t as, kdump_addr_t addr,
 	do {
 		size_t off, partlen;
 
-		pio.addr.as = as;
+		pio.addr.as = (addrxlat_addrspace_t) as;
 		pio.addr.addr = page_align(ctx, addr);
+		pio.buf = NULL;
 		ret = get_page_maybe_xlat(ctx, &pio);
 		if (ret != KDUMP_OK)
 			return ret;
@@ -38,8 +38,11 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <errno.h>
+#include <limits.h>
 
-#if USE_ZLIB
+#if USE_LIBDEFLATE
+# include <libdeflate.h>
+#elif USE_ZLIB
 # include <zlib.h>
 #endif
 
@@ -543,7 +546,7 @@ const struct attr_ops xen_ver_ops = {
  *
  * This function can be used as the @c realloc_caches method if
  * the cache is organized as @c cache.size elements of @c arch.page_size
- * bytes each.
+ * bytes each, split into @c cache.shards shards.
  */
 kdump_status
 def_realloc_caches(kdump_ctx_t *ctx)
@@ -552,11 +555,15 @@ def_realloc_caches(kdump_ctx_t *ctx)
 	struct cache *cache;
 	kdump_status status;
 
-	cache = cache_alloc(cache_size, get_page_size(ctx));
+	cache = cache_alloc_sharded(cache_size, get_page_size(ctx),
+				    get_cache_shards(ctx));
 	if (!cache)
 		return set_error(ctx, KDUMP_ERR_SYSTEM,
 				 "Cannot allocate cache (%u * %zu bytes)",
 				 cache_size, get_page_size(ctx));
+	set_cache_full_policy(cache,
+			      attr_value(gattr(ctx, GKI_cache_full_policy))
+			      ->number);
 
 	status = cache_set_attrs(cache, ctx,
 				 gattr(ctx, GKI_cache_hits),
@@ -596,6 +603,64 @@ const struct attr_ops cache_size_ops = {
 	.post_set = cache_size_post_hook,
 };
 
+static kdump_status
+cache_shards_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+		      kdump_attr_value_t *val)
+{
+	if (val->number == 0)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Cache must have at least one shard");
+	if (val->number > UINT_MAX)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Too many cache shards (max %u)", UINT_MAX);
+	return KDUMP_OK;
+}
+
+const struct attr_ops cache_shards_ops = {
+	.pre_set = cache_shards_pre_hook,
+	.post_set = cache_size_post_hook,
+};
+
+static kdump_status
+cache_readahead_window_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+				kdump_attr_value_t *val)
+{
+	if (val->number > UINT_MAX)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Readahead window too big (max %u)",
+				 UINT_MAX);
+	return KDUMP_OK;
+}
+
+const struct attr_ops cache_readahead_window_ops = {
+	.pre_set = cache_readahead_window_pre_hook,
+};
+
+static kdump_status
+cache_full_policy_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
+			   kdump_attr_value_t *val)
+{
+	if (val->number > KDUMP_CACHE_FULL_GROW)
+		return set_error(ctx, KDUMP_ERR_INVALID,
+				 "Invalid cache full policy: %" KDUMP_PRIuNUM,
+				 val->number);
+	return KDUMP_OK;
+}
+
+static kdump_status
+cache_full_policy_post_hook(kdump_ctx_t *ctx, struct attr_data *attr)
+{
+	if (ctx->shared->cache)
+		set_cache_full_policy(ctx->shared->cache,
+				      attr_value(attr)->number);
+	return KDUMP_OK;
+}
+
+const struct attr_ops cache_full_policy_ops = {
+	.pre_set = cache_full_policy_pre_hook,
+	.post_set = cache_full_policy_post_hook,
+};
+
 static kdump_status
 page_size_pre_hook(kdump_ctx_t *ctx, struct attr_data *attr,
 		   kdump_attr_value_t *newval)
@@ -746,7 +811,26 @@ uncompress_rle(unsigned char *dst, size_t *pdstlen,
 	return 0;
 }
 
-#if USE_ZLIB
+#if USE_LIBDEFLATE
+/** Per-context libdeflate decompression state. */
+struct gzip_state {
+	/** Decompressor, allocated on first use. */
+	struct libdeflate_decompressor *decomp;
+};
+
+/**  Free per-context libdeflate decompression state.
+ * @param data  Per-context data (@ref gzip_state).
+ */
+static void
+gzip_state_cleanup(void *data)
+{
+	struct gzip_state *gz = data;
+
+	if (gz->decomp)
+		libdeflate_free_decompressor(gz->decomp);
+}
+
+#elif USE_ZLIB
 static kdump_status
 set_zlib_error(kdump_ctx_t *ctx, const char *what,
 	       const z_stream *zstream, int err)
@@ -761,51 +845,114 @@ set_zlib_error(kdump_ctx_t *ctx, const char *what,
 	return set_error(ctx, KDUMP_ERR_CORRUPT,
 			 "%s: %s", what, zstream->msg);
 }
+
+/** Per-context zlib decompression state. */
+struct gzip_state {
+	z_stream zstream;	/**< Inflate stream. */
+	bool initialized;	/**< Set after successful @c inflateInit. */
+};
+
+/**  Free per-context zlib decompression state.
+ * @param data  Per-context data (@ref gzip_state).
+ */
+static void
+gzip_state_cleanup(void *data)
+{
+	struct gzip_state *gz = data;
+
+	if (gz->initialized)
+		inflateEnd(&gz->zstream);
+}
+#endif
+
+#if USE_LIBDEFLATE || USE_ZLIB
+/**  Allocate per-context zlib decompression state.
+ * @param shared  Dump file shared data.
+ * @returns       Per-context slot number, or -1 on error.
+ *
+ * Pass the slot number to @ref uncompress_page_gzip. The decompressor
+ * is initialized on first use and then reused for each page, so its
+ * state is not reallocated for every page.
+ *
+ * On error, @c errno is set as for @ref per_ctx_alloc.
+ */
+int
+gzip_slot_alloc(struct kdump_shared *shared)
+{
+	return per_ctx_alloc(shared, sizeof(struct gzip_state),
+			     gzip_state_cleanup);
+}
 #endif
 
 /**  Uncompress a gzipp'ed page.
  * @param ctx     Dump file object.
+ * @param slot    Per-context slot from @ref gzip_slot_alloc.
  * @param dst     Destination buffer.
  * @param src     Source (compressed) data.
  * @param srclen  Length of source data.
  */
 kdump_status
-uncompress_page_gzip(kdump_ctx_t *ctx, unsigned char *dst,
+uncompress_page_gzip(kdump_ctx_t *ctx, int slot, unsigned char *dst,
 		     unsigned char *src, size_t srclen)
 {
-#if USE_ZLIB
-	z_stream zstream;
+#if USE_LIBDEFLATE
+	struct gzip_state *gz = ctx->data[slot];
+	enum libdeflate_result res;
+	size_t retlen;
+
+	if (!gz->decomp) {
+		gz->decomp = libdeflate_alloc_decompressor();
+		if (!gz->decomp)
+			return set_error(ctx, KDUMP_ERR_SYSTEM,
+					 "Cannot allocate decompressor");
+	}
+
+	/* Each page is a complete zlib stream of known size. */
+	res = libdeflate_zlib_decompress(gz->decomp, src, srclen,
+					 dst, get_page_size(ctx), &retlen);
+	if (res != LIBDEFLATE_SUCCESS)
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Decompression failed: %d", (int) res);
+
+	if (retlen != get_page_size(ctx))
+		return set_error(ctx, KDUMP_ERR_CORRUPT,
+				 "Wrong uncompressed size: %lu",
+				 (unsigned long) retlen);
+
+	return KDUMP_OK;
+
+#elif USE_ZLIB
+	struct gzip_state *gz = ctx->data[slot];
+	z_stream *zstream = &gz->zstream;
 	int res;
 
-	memset(&zstream, 0, sizeof zstream);
-	zstream.next_in = (z_const Bytef *)src;
-	zstream.avail_in = srclen;
-	zstream.next_out = dst;
-	zstream.avail_out = get_page_size(ctx);
+	zstream->next_in = (z_const Bytef *)src;
+	zstream->avail_in = srclen;
+	zstream->next_out = dst;
+	zstream->avail_out = get_page_size(ctx);
 
-	res = inflateInit(&zstream);
+	if (gz->initialized)
+		res = inflateReset(zstream);
+	else {
+		res = inflateInit(zstream);
+		gz->initialized = (res == Z_OK);
+	}
 	if (res != Z_OK)
-		return set_zlib_error(ctx, "Cannot init zlib", &zstream, res);
+		return set_zlib_error(ctx, "Cannot init zlib", zstream, res);
 
-	res = inflate(&zstream, Z_FINISH);
+	res = inflate(zstream, Z_FINISH);
 	if (res != Z_STREAM_END) {
-		inflateEnd(&zstream);
 		if (res == Z_NEED_DICT ||
-		    (res == Z_BUF_ERROR && zstream.avail_in == 0))
+		    (res == Z_BUF_ERROR && zstream->avail_in == 0))
 			res = Z_DATA_ERROR;
 		return set_zlib_error(ctx, "Decompresion failed",
-				      &zstream, res);
+				      zstream, res);
 	}
 
-	res = inflateEnd(&zstream);
-	if (res != Z_OK)
-		return set_zlib_error(ctx, "Decompression failed",
-				      &zstream, res);
-
-	if (zstream.avail_out)
+	if (zstream->avail_out)
 		return set_error(ctx, KDUMP_ERR_CORRUPT,
 				 "Wrong uncompressed size: %lu",
-				 (unsigned long) zstream.total_out);
+				 (unsigned long) zstream->total_out);
 
 	return KDUMP_OK;
 
@@ -512,6 +512,184 @@ const struct attr_ops xen_dirty_xlat_ops = {
 	.pre_clear = (attr_pre_clear_fn*)xen_dirty_xlat_hook,
 };
 
+/**  Flush the TLB if the translation system has changed.
+ * @param ctx  Dump file object.
+ *
+ * TLB entries hold the final translation, so they are also flushed if
+ * the address space capabilities change.
+ */
+static void
+tlb_revalidate(kdump_ctx_t *ctx)
+{
+	struct kdump_tlb *tlb = &ctx->tlb;
+	unsigned long gen = addrxlat_sys_get_gen(ctx->xlat->xlatsys);
+
+	if (tlb->gen == gen && tlb->caps == ctx->xlat->xlat_caps)
+		return;
+
+	memset(tlb->entry, 0, sizeof tlb->entry);
+	tlb->nsizes = 0;
+	tlb->gen = gen;
+	tlb->caps = ctx->xlat->xlat_caps;
+}
+
+/**  Look up a virtual address in the TLB.
+ * @param tlb   Translation lookaside buffer.
+ * @param addr  Virtual address.
+ * @returns     Matching TLB entry, or @c NULL if not found.
+ */
+static const struct tlb_entry *
+tlb_lookup(const struct kdump_tlb *tlb, kdump_addr_t addr)
+{
+	unsigned i, way;
+
+	for (i = 0; i < tlb->nsizes; ++i) {
+		unsigned shift = tlb->shift[i];
+		kdump_addr_t vpn = addr >> shift;
+		const struct tlb_entry *set = tlb->entry[vpn % TLB_SETS];
+
+		for (way = 0; way < TLB_WAYS; ++way)
+			if (set[way].shift == shift && set[way].vpn == vpn)
+				return &set[way];
+	}
+	return NULL;
+}
+
+/**  Add a translation to the TLB.
+ * @param tlb    Translation lookaside buffer.
+ * @param addr   Virtual address.
+ * @param phys   Translation of @p addr.
+ * @param shift  Log2 of the size of the page containing @p addr.
+ *
+ * If there is no room for another page size, the translation is
+ * stored with the largest known page size that is smaller than
+ * @p shift. If there is no such page size, nothing is stored.
+ */
+static void
+tlb_insert(struct kdump_tlb *tlb, kdump_addr_t addr,
+	   const addrxlat_fulladdr_t *phys, unsigned shift)
+{
+	struct tlb_entry *entry;
+	kdump_addr_t vpn;
+	unsigned i, set;
+
+	for (i = 0; i < tlb->nsizes; ++i)
+		if (tlb->shift[i] == shift)
+			break;
+	if (i >= tlb->nsizes) {
+		if (tlb->nsizes < TLB_SIZES) {
+			tlb->shift[tlb->nsizes++] = shift;
+		} else {
+			unsigned best = 0;
+			for (i = 0; i < tlb->nsizes; ++i)
+				if (tlb->shift[i] < shift &&
+				    tlb->shift[i] > best)
+					best = tlb->shift[i];
+			if (!best)
+				return;
+			shift = best;
+		}
+	}
+
+	vpn = addr >> shift;
+	set = vpn % TLB_SETS;
+	entry = &tlb->entry[set][tlb->next[set]];
+	tlb->next[set] = (tlb->next[set] + 1) % TLB_WAYS;
+
+	entry->vpn = vpn;
+	entry->phys.as = phys->as;
+	entry->phys.addr = phys->addr - (addr & (((kdump_addr_t)1 << shift) - 1));
+	entry->shift = shift;
+}
+
+/**  Addrxlat operation which stores the translated address.
+ * @param data  Pointer to the full address.
+ * @param addr  Translated address.
+ * @returns     Always @c ADDRXLAT_OK.
+ */
+static addrxlat_status
+tlb_store_op(void *data, const addrxlat_fulladdr_t *addr)
+{
+	*(addrxlat_fulladdr_t*)data = *addr;
+	return ADDRXLAT_OK;
+}
+
+/**  Translate a kernel virtual address and add it to the TLB.
+ * @param ctx   Dump file object.
+ * @param addr  Kernel virtual address; updated on success.
+ *
+ * The address is translated with @ref addrxlat_op_block, and the
+ * largest aligned page which lies within the returned block is added
+ * to the TLB.
+ */
+static void
+tlb_fill(kdump_ctx_t *ctx, addrxlat_fulladdr_t *addr)
+{
+	addrxlat_op_ctl_t ctl;
+	addrxlat_fulladdr_t phys;
+	addrxlat_addr_t below, above, mask;
+	unsigned shift;
+
+	ctl.ctx = ctx->xlatctx;
+	ctl.sys = ctx->xlat->xlatsys;
+	ctl.op = tlb_store_op;
+	ctl.data = &phys;
+	ctl.caps = ctx->xlat->xlat_caps;
+	if (addrxlat_op_block(&ctl, addr, &below, &above) != ADDRXLAT_OK)
+		return;
+
+	shift = get_page_shift(ctx);
+	mask = ((kdump_addr_t)1 << shift) - 1;
+	if ((addr->addr & mask) > below || mask - (addr->addr & mask) > above)
+		return;
+	while (shift < BITS_PER_BYTE * sizeof(kdump_addr_t) - 1) {
+		mask = (mask << 1) | 1;
+		if ((addr->addr & mask) > below ||
+		    mask - (addr->addr & mask) > above)
+			break;
+		++shift;
+	}
+
+	tlb_insert(&ctx->tlb, addr->addr, &phys, shift);
+	*addr = phys;
+}
+
+/**  Translate a kernel virtual address using the TLB.
+ * @param ctx   Dump file object.
+ * @param addr  Address to be translated; updated on success.
+ *
+ * If the translation is not found in the TLB, the address is translated
+ * by libaddrxlat and the result is added to the TLB. The address is left
+ * unchanged if it cannot be translated; the caller should then use
+ * @ref addrxlat_op, which also provides a proper error message.
+ */
+void
+tlb_translate(kdump_ctx_t *ctx, addrxlat_fulladdr_t *addr)
+{
+	struct kdump_tlb *tlb = &ctx->tlb;
+	const struct tlb_entry *entry;
+
+	if (!ctx->xlat->xlatsys)
+		return;
+
+	tlb_revalidate(ctx);
+	entry = tlb_lookup(tlb, addr->addr);
+	if (entry) {
+		addr->as = entry->phys.as;
+		addr->addr = entry->phys.addr +
+			(addr->addr & (((kdump_addr_t)1 << entry->shift) - 1));
+		return;
+	}
+
+	/* Page tables may be in virtual memory; do not recurse. */
+	if (tlb->busy)
+		return;
+
+	tlb->busy = true;
+	tlb_fill(ctx, addr);
+	tlb->busy = false;
+}
+
 /**  Addrxlat get_page callback.
  * @param data  Dump file object.
  * @param buf   Page buffer metadata.
@@ -537,6 +715,7 @@ addrxlat_get_page(void *data, addrxlat_buffer_t *buf)
 
 	pio->addr.addr = buf->addr.addr;
 	pio->addr.as = buf->addr.as;
+	pio->buf = NULL;
 	status = get_page(ctx, pio);
 	if (status != KDUMP_OK)
 		return kdump2addrxlat(ctx, status);
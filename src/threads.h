@@ -69,6 +69,47 @@ mutex_unlock(mutex_t *mutex)
 	return pthread_mutex_unlock(mutex);
 }
 
+typedef pthread_cond_t cond_t;
+typedef pthread_condattr_t condattr_t;
+
+static inline int
+cond_init(cond_t *cond, const condattr_t *attr)
+{
+	return pthread_cond_init(cond, attr);
+}
+
+static inline int
+cond_destroy(cond_t *cond)
+{
+	return pthread_cond_destroy(cond);
+}
+
+static inline int
+cond_wait(cond_t *cond, mutex_t *mutex)
+{
+	return pthread_cond_wait(cond, mutex);
+}
+
+static inline int
+cond_broadcast(cond_t *cond)
+{
+	return pthread_cond_broadcast(cond);
+}
+
+typedef pthread_t thread_t;
+
+static inline int
+thread_create(thread_t *thread, void *(*fn)(void *), void *arg)
+{
+	return pthread_create(thread, NULL, fn, arg);
+}
+
+static inline int
+thread_join(thread_t thread, void **retval)
+{
+	return pthread_join(thread, retval);
+}
+
 typedef pthread_rwlock_t rwlock_t;
 typedef pthread_rwlockattr_t rwlockattr_t;
 
@@ -104,6 +145,8 @@ rwlock_unlock(rwlock_t *rwlock)
 
 #else  /* USE_PTHREAD */
 
+#include <errno.h>
+
 typedef struct { } mutex_t;
 typedef struct { } mutexattr_t;
 
@@ -137,6 +180,49 @@ mutex_unlock(mutex_t *mutex)
 	return 0;
 }
 
+typedef struct { } cond_t;
+typedef struct { } condattr_t;
+
+static inline int
+cond_init(cond_t *cond, const condattr_t *attr)
+{
+	return 0;
+}
+
+static inline int
+cond_destroy(cond_t *cond)
+{
+	return 0;
+}
+
+/* Without threads, nobody else can signal the condition. */
+static inline int
+cond_wait(cond_t *cond, mutex_t *mutex)
+{
+	return EDEADLK;
+}
+
+static inline int
+cond_broadcast(cond_t *cond)
+{
+	return 0;
+}
+
+typedef struct { } thread_t;
+
+/* Callers must be prepared to do the work synchronously. */
+static inline int
+thread_create(thread_t *thread, void *(*fn)(void *), void *arg)
+{
+	return ENOSYS;
+}
+
+static inline int
+thread_join(thread_t thread, void **retval)
+{
+	return ESRCH;
+}
+
 typedef struct { } rwlock_t;
 typedef struct { } rwlockattr_t;
 
@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <libkdumpfile/addrxlat.h>
 
 #include "testutil.h"
@@ -54,19 +55,37 @@ int
 main(int argc, char **argv)
 {
 	addrxlat_map_t *map;
+	addrxlat_map_ent_t *ents;
 	addrxlat_range_t range;
 	addrxlat_addr_t addr;
 	addrxlat_status status;
 	unsigned long methidx;
 	char *endp;
+	int bulk;
+	int opt;
 	int i;
 
+	bulk = 0;
+	while ((opt = getopt(argc, argv, "b")) != -1) {
+		switch (opt) {
+		case 'b':
+			bulk = 1;
+			break;
+
+		default:
+			fprintf(stderr, "Usage: %s [-b] <range>...\n",
+				argv[0]);
+			return TEST_ERR;
+		}
+	}
+
 	map = addrxlat_map_new();
-	if (!map) {
+	ents = malloc(argc * sizeof(*ents));
+	if (!map || !ents) {
 		perror("Cannot allocate map");
 		return TEST_ERR;
 	}
-	for (i = 1; i < argc; ++i) {
+	for (i = optind; i < argc; ++i) {
 		addr = strtoull(argv[i], &endp, 0);
 		if (*endp != '-') {
 			fprintf(stderr, "Invalid range spec: %s\n", argv[i]);
@@ -87,6 +106,12 @@ main(int argc, char **argv)
 		}
 
 		range.meth = methidx;
+		if (bulk) {
+			ents[i - optind].addr = addr;
+			ents[i - optind].range = range;
+			continue;
+		}
+
 		status = addrxlat_map_set(map, addr, &range);
 		if (status != ADDRXLAT_OK) {
 			fprintf(stderr, "Cannot add range: %s\n",
@@ -95,6 +120,16 @@ main(int argc, char **argv)
 		}
 	}
 
+	if (bulk) {
+		status = addrxlat_map_set_bulk(map, ents, argc - optind);
+		if (status != ADDRXLAT_OK) {
+			fprintf(stderr, "Cannot set ranges: %s\n",
+				addrxlat_strerror(status));
+			return TEST_ERR;
+		}
+	}
+	free(ents);
+
 	if (map) {
 		printmap(map);
 		addrxlat_map_decref(map);
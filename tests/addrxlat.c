@@ -315,7 +315,7 @@ static void
 usage(const char *name)
 {
 	fprintf(stderr,
-		"Usage: %s [<options>] <addr>\n"
+		"Usage: %s [<options>] <addr>...\n"
 		"\n"
 		"Options:\n"
 		"  -l|--linear off       Use linear transation\n"
@@ -341,7 +341,7 @@ main(int argc, char **argv)
 			      ADDRXLAT_CAPS(ADDRXLAT_KVADDR))
 	};
 	addrxlat_meth_t pgt, linear, lookup, memarr, *meth;
-	int opt;
+	int opt, i;
 	unsigned long refcnt;
 	int rc;
 
@@ -433,15 +433,17 @@ main(int argc, char **argv)
 		return TEST_ERR;
 	}
 
-	if (argc - optind != 1 || !*argv[optind]) {
-		fprintf(stderr, "Usage: %s <addr>\n", argv[0]);
+	if (argc - optind < 1) {
+		fprintf(stderr, "Usage: %s <addr>...\n", argv[0]);
 		return TEST_ERR;
 	}
 
-	vaddr = strtoull(argv[optind], &endp, 0);
-	if (*endp) {
-		fprintf(stderr, "Invalid address: %s\n", argv[optind]);
-		return TEST_ERR;
+	for (i = optind; i < argc; ++i) {
+		strtoull(argv[i], &endp, 0);
+		if (!*argv[i] || *endp) {
+			fprintf(stderr, "Invalid address: %s\n", argv[i]);
+			return TEST_ERR;
+		}
 	}
 
 	lookup.param.lookup.nelem = nentries;
@@ -456,7 +458,10 @@ main(int argc, char **argv)
 	cb.data = ctx;
 	addrxlat_ctx_set_cb(ctx, &cb);
 
-	rc = do_xlat(ctx, meth, vaddr);
+	for (i = optind, rc = TEST_OK; i < argc && rc == TEST_OK; ++i) {
+		vaddr = strtoull(argv[i], &endp, 0);
+		rc = do_xlat(ctx, meth, vaddr);
+	}
 
  out:
 	if (ctx && (refcnt = addrxlat_ctx_decref(ctx)) != 0)
@@ -37,11 +37,23 @@
 #include "testutil.h"
 
 #define CHUNKSZ 256
+#define STREAMSZ 0x10000
+#define VECSZ 24
 #define BYTES_PER_LINE 16
+#define MAXFILES 16
 
 static const char *ostype = NULL;
+static const char *indexfile = NULL;
 static unsigned long valsz = 1;
 static int zero_excluded;
+static int zero_stats;
+static int pinned;
+static int vectored;
+static int streaming;
+static unsigned long readahead;
+static unsigned long index_threads;
+static const char *splitfiles[MAXFILES - 1];
+static unsigned nsplitfiles;
 
 static inline int
 endofline(unsigned long long addr)
@@ -99,21 +111,33 @@ static int
 dump_data(kdump_ctx_t *ctx, kdump_addrspace_t as, unsigned long long addr,
 	  unsigned long long len)
 {
-	unsigned char buf[CHUNKSZ];
-	size_t sz, remain;
+	static unsigned char buf[STREAMSZ];
+	size_t chunksz, sz, remain;
+	unsigned long flags;
 	kdump_status res;
 	int iserr;
 	int rc = TEST_OK;
 
+	if (streaming) {
+		chunksz = STREAMSZ;
+		flags = KDUMP_READ_STREAM;
+	} else {
+		chunksz = CHUNKSZ;
+		flags = 0;
+	}
+
 	iserr = 0;
 	while (len > 0) {
-		sz = (len >= CHUNKSZ) ? CHUNKSZ : len;
+		sz = (len >= chunksz) ? chunksz : len;
 		len -= sz;
 
 		remain = sz;
 		while (remain) {
 			sz = remain;
-			res = kdump_read(ctx, as, addr, buf, &sz);
+			res = flags
+				? kdump_read_flags(ctx, as, addr, buf, &sz,
+						   flags)
+				: kdump_read(ctx, as, addr, buf, &sz);
 			dump_buffer(ctx, addr, buf, sz);
 			addr += sz;
 			remain -= sz;
@@ -140,6 +164,100 @@ dump_data(kdump_ctx_t *ctx, kdump_addrspace_t as, unsigned long long addr,
 	return rc;
 }
 
+static int
+dump_data_pinned(kdump_ctx_t *ctx, kdump_addrspace_t as,
+		 unsigned long long addr, unsigned long long len)
+{
+	kdump_page_t page;
+	size_t off, sz;
+	kdump_status res;
+	int iserr;
+	int rc = TEST_OK;
+
+	iserr = 0;
+	while (len > 0) {
+		res = kdump_get_page(ctx, as, addr, &page);
+		if (res != KDUMP_OK) {
+			if (!iserr) {
+				fprintf(stderr, "Read failed at 0x%llx: %s\n",
+					addr, kdump_get_err(ctx));
+				iserr = 1;
+				rc = TEST_FAIL;
+			}
+			--len;
+			printf("??%c", separator(++addr));
+			continue;
+		}
+		iserr = 0;
+
+		off = addr - page.addr;
+		sz = page.size - off;
+		if (sz > len)
+			sz = len;
+		dump_buffer(ctx, addr, (unsigned char *)page.data + off, sz);
+		kdump_put_page(ctx, &page);
+		addr += sz;
+		len -= sz;
+	}
+
+	if (!endofline(addr))
+		putchar('\n');
+
+	return rc;
+}
+
+static int
+dump_data_vec(kdump_ctx_t *ctx, kdump_addrspace_t as,
+	      unsigned long long addr, unsigned long long len)
+{
+	unsigned char *buf;
+	kdump_iovec_t *vec, *v;
+	size_t i, n, want;
+	kdump_status res;
+	int rc = TEST_OK;
+
+	n = (len + VECSZ - 1) / VECSZ;
+	buf = malloc(len);
+	vec = malloc(n * sizeof *vec);
+	if (!buf || !vec) {
+		perror("Cannot allocate read vector");
+		free(buf);
+		free(vec);
+		return TEST_ERR;
+	}
+
+	/* Fill the vector in reverse order to exercise sorting. */
+	for (i = 0; i < n; ++i) {
+		v = &vec[n - 1 - i];
+		v->addr = addr + i * VECSZ;
+		v->buf = buf + i * VECSZ;
+		v->len = (i < n - 1) ? VECSZ : len - i * VECSZ;
+	}
+
+	res = kdump_readv(ctx, as, vec, n);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Vectored read failed: %s\n",
+			kdump_get_err(ctx));
+		rc = TEST_FAIL;
+	}
+
+	for (i = 0; i < n; ++i) {
+		v = &vec[n - 1 - i];
+		want = (i < n - 1) ? VECSZ : len - i * VECSZ;
+		dump_buffer(ctx, v->addr, v->buf, v->len);
+		addr = v->addr + v->len;
+		while (want-- > v->len)
+			printf("??%c", separator(++addr));
+	}
+
+	if (!endofline(addr))
+		putchar('\n');
+
+	free(buf);
+	free(vec);
+	return rc;
+}
+
 static addrxlat_addrspace_t
 get_addrspace(const char *p, const char *endp)
 {
@@ -154,7 +272,7 @@ get_addrspace(const char *p, const char *endp)
 }
 
 static int
-dump_data_fd(int fd, char **argv)
+dump_data_fd(const int *fds, unsigned nfds, char **argv)
 {
 	kdump_ctx_t *ctx;
 	kdump_status res;
@@ -175,6 +293,26 @@ dump_data_fd(int fd, char **argv)
 		}
 	}
 
+	if (indexfile) {
+		res = kdump_set_string_attr(ctx, KDUMP_ATTR_FILE_INDEX,
+					    indexfile);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set index file: %s\n",
+				kdump_get_err(ctx));
+			goto err;
+		}
+	}
+
+	if (index_threads) {
+		res = kdump_set_number_attr(ctx, KDUMP_ATTR_FILE_INDEX_THREADS,
+					    index_threads);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set index threads: %s\n",
+				kdump_get_err(ctx));
+			goto err;
+		}
+	}
+
 	if (zero_excluded) {
 		res = kdump_set_number_attr(ctx, KDUMP_ATTR_ZERO_EXCLUDED, 1);
 		if (res != KDUMP_OK) {
@@ -184,7 +322,22 @@ dump_data_fd(int fd, char **argv)
 		}
 	}
 
-	res = kdump_set_number_attr(ctx, KDUMP_ATTR_FILE_FD, fd);
+	if (readahead) {
+		res = kdump_set_number_attr(ctx, KDUMP_ATTR_CACHE_READAHEAD, 1);
+		if (res == KDUMP_OK)
+			res = kdump_set_number_attr(
+				ctx, KDUMP_ATTR_CACHE_READAHEAD_WINDOW,
+				readahead);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set readahead: %s\n",
+				kdump_get_err(ctx));
+			goto err;
+		}
+	}
+
+	res = (nfds > 1)
+		? kdump_open_fdset(ctx, nfds, fds)
+		: kdump_set_number_attr(ctx, KDUMP_ATTR_FILE_FD, fds[0]);
 	if (res != KDUMP_OK) {
 		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
 		goto err;
@@ -222,13 +375,32 @@ dump_data_fd(int fd, char **argv)
 				return TEST_ERR;
 			}
 
-			rc = dump_data(ctx, as, addr, len * valsz);
+			if (pinned)
+				rc = dump_data_pinned(ctx, as, addr,
+						      len * valsz);
+			else if (vectored)
+				rc = dump_data_vec(ctx, as, addr, len * valsz);
+			else
+				rc = dump_data(ctx, as, addr, len * valsz);
 			if (rc != KDUMP_OK)
 				break;
 			argv += 2;
 		}
 	}
 
+	if (zero_stats) {
+		kdump_num_t num;
+
+		res = kdump_get_number_attr(ctx, KDUMP_ATTR_CACHE_ZERO_PAGES,
+					    &num);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot get zero page count: %s\n",
+				kdump_get_err(ctx));
+			goto err;
+		}
+		fprintf(stderr, "zero_pages = %llu\n", (unsigned long long)num);
+	}
+
 	kdump_free(ctx);
 	return rc;
 
@@ -244,26 +416,60 @@ usage(const char *name)
 		"Usage: %s [<options>] <dump> <addr> <len> [...]\n"
 		"\n"
 		"Options:\n"
+		"  -f file    Open another file of a split dump\n"
+		"  -i file    Use a sidecar index file\n"
 		"  -o ostype  Set OS type\n"
+		"  -p         Read pinned pages (zero-copy)\n"
+		"  -r window  Enable readahead with this window (in pages)\n"
 		"  -s size    Set value size in bytes\n"
-		"  -z         Fill excluded pages with zeroes\n",
+		"  -S         Use streaming reads (bypass the cache)\n"
+		"  -t num     Index pages with this many background threads\n"
+		"  -v         Use a single vectored read\n"
+		"  -z         Fill excluded pages with zeroes\n"
+		"  -Z         Print the number of shared zero page reads\n",
 		name);
 }
 
 int
 main(int argc, char **argv)
 {
+	int fds[MAXFILES];
+	unsigned nfds, i;
 	char *endp;
 	int opt;
-	int fd;
 	int rc;
 
-	while ((opt = getopt(argc, argv, "ho:s:z")) != -1) {
+	while ((opt = getopt(argc, argv, "f:hi:o:pr:s:St:vzZ")) != -1) {
 		switch (opt) {
+		case 'f':
+			if (nsplitfiles >= MAXFILES - 1) {
+				fprintf(stderr, "Too many files\n");
+				return TEST_ERR;
+			}
+			splitfiles[nsplitfiles++] = optarg;
+			break;
+
+		case 'i':
+			indexfile = optarg;
+			break;
+
 		case 'o':
 			ostype = optarg;
 			break;
 
+		case 'p':
+			pinned = 1;
+			break;
+
+		case 'r':
+			readahead = strtoul(optarg, &endp, 0);
+			if (endp == optarg || *endp || !readahead) {
+				fprintf(stderr, "Invalid window: %s\n",
+					optarg);
+				return TEST_ERR;
+			}
+			break;
+
 		case 's':
 			valsz = strtoul(optarg, &endp, 0);
 			if (endp == optarg || *endp ||
@@ -274,10 +480,31 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'S':
+			streaming = 1;
+			break;
+
+		case 't':
+			index_threads = strtoul(optarg, &endp, 0);
+			if (endp == optarg || *endp) {
+				fprintf(stderr, "Invalid thread count: %s\n",
+					optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'v':
+			vectored = 1;
+			break;
+
 		case 'z':
 			zero_excluded = 1;
 			break;
 
+		case 'Z':
+			zero_stats = 1;
+			break;
+
 		case 'h':
 		default:
 			usage(argv[0]);
@@ -290,18 +517,27 @@ main(int argc, char **argv)
 		return TEST_ERR;
 	}
 
-	fd = open(argv[optind], O_RDONLY);
-	if (fd < 0) {
-		perror("open dump");
-		return TEST_ERR;
+	rc = TEST_OK;
+	for (nfds = 0; nfds <= nsplitfiles; ++nfds) {
+		const char *name = nfds
+			? splitfiles[nfds - 1]
+			: argv[optind];
+		fds[nfds] = open(name, O_RDONLY);
+		if (fds[nfds] < 0) {
+			perror(name);
+			rc = TEST_ERR;
+			break;
+		}
 	}
 
-	rc = dump_data_fd(fd, argv + optind + 1);
+	if (rc == TEST_OK)
+		rc = dump_data_fd(fds, nfds, argv + optind + 1);
 
-	if (close(fd) < 0) {
-		perror("close dump");
-		rc = TEST_ERR;
-	}
+	for (i = 0; i < nfds; ++i)
+		if (close(fds[i]) < 0) {
+			perror("close dump");
+			rc = TEST_ERR;
+		}
 
 	return rc;
 }
@@ -0,0 +1,234 @@
+/* Random lookups in address translation maps.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <libkdumpfile/addrxlat.h>
+
+#include "testutil.h"
+
+#define DEFITER		1000000
+
+/* Distance between range start addresses. */
+#define STEP		0x100000
+
+/* Number of distinct methods used in a map. */
+#define NMETH		8
+
+static unsigned long niter = DEFITER;
+static int report;
+static int bulk;
+
+/* Get the method expected at a given address. */
+static addrxlat_sys_meth_t
+expected_meth(addrxlat_addr_t addr, unsigned long nranges)
+{
+	unsigned long idx = addr / STEP;
+
+	if (idx >= nranges || addr % STEP > STEP - 1 - (idx % 3) * 0x1000)
+		return ADDRXLAT_SYS_METH_NONE;
+	return idx % NMETH;
+}
+
+/* Make a map with nranges ranges. Some ranges are followed by a gap.
+ * In bulk mode, the ranges are passed in reverse order. */
+static addrxlat_map_t *
+make_map(unsigned long nranges)
+{
+	addrxlat_map_t *map;
+	addrxlat_map_ent_t *ents;
+	addrxlat_status status;
+	unsigned long i;
+
+	map = addrxlat_map_new();
+	ents = malloc(nranges * sizeof(*ents));
+	if (!map || !ents) {
+		perror("Cannot allocate map");
+		if (map)
+			addrxlat_map_decref(map);
+		free(ents);
+		return NULL;
+	}
+
+	for (i = 0; i < nranges; ++i) {
+		addrxlat_map_ent_t *ent = &ents[bulk ? nranges - 1 - i : i];
+		ent->addr = i * STEP;
+		ent->range.endoff = STEP - 1 - (i % 3) * 0x1000;
+		ent->range.meth = i % NMETH;
+	}
+
+	if (bulk)
+		status = addrxlat_map_set_bulk(map, ents, nranges);
+	else
+		for (i = 0, status = ADDRXLAT_OK;
+		     i < nranges && status == ADDRXLAT_OK; ++i)
+			status = addrxlat_map_set(map, ents[i].addr,
+						  &ents[i].range);
+	free(ents);
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot add range: %s\n",
+			addrxlat_strerror(status));
+		addrxlat_map_decref(map);
+		return NULL;
+	}
+
+	return map;
+}
+
+static addrxlat_addr_t
+random_addr(unsigned long nranges)
+{
+	addrxlat_addr_t addr;
+
+	addr = ((addrxlat_addr_t)lrand48() << 31) | lrand48();
+	return addr % ((nranges + 1) * STEP);
+}
+
+static int
+run_lookups(unsigned long nranges)
+{
+	struct timespec start, built, end;
+	addrxlat_map_t *map;
+	addrxlat_addr_t addr;
+	addrxlat_sys_meth_t meth;
+	unsigned long i, nfound;
+	int rc;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	map = make_map(nranges);
+	if (!map)
+		return TEST_ERR;
+	clock_gettime(CLOCK_MONOTONIC, &built);
+
+	/* Timed lookups. */
+	nfound = 0;
+	for (i = 0; i < niter; ++i)
+		if (addrxlat_map_search(map, random_addr(nranges)) !=
+		    ADDRXLAT_SYS_METH_NONE)
+			++nfound;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Verify a sample of lookups. */
+	rc = TEST_OK;
+	for (i = 0; i < niter / 16; ++i) {
+		addr = random_addr(nranges);
+		meth = addrxlat_map_search(map, addr);
+		if (meth != expected_meth(addr, nranges)) {
+			fprintf(stderr, "Mismatch at 0x%"ADDRXLAT_PRIxADDR
+				": expected %ld, got %ld\n", addr,
+				(long) expected_meth(addr, nranges),
+				(long) meth);
+			rc = TEST_FAIL;
+			break;
+		}
+	}
+
+	if (report && rc == TEST_OK) {
+		double buildtime = (built.tv_sec - start.tv_sec) +
+			(built.tv_nsec - start.tv_nsec) / 1e9;
+		double elapsed = (end.tv_sec - built.tv_sec) +
+			(end.tv_nsec - built.tv_nsec) / 1e9;
+		printf("%lu ranges (%zu map entries) built in %.6f s:"
+		       " %lu lookups (%lu found): %.0f lookups/s\n",
+		       nranges, addrxlat_map_len(map), buildtime,
+		       niter, nfound, niter / elapsed);
+	}
+
+	addrxlat_map_decref(map);
+	return rc;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [<options>] <num-ranges> [...]\n"
+		"\n"
+		"Options:\n"
+		"  -b              Build maps with addrxlat_map_set_bulk()\n"
+		"  -i iterations   Number of lookups (default: %u)\n"
+		"  -r              Report lookup throughput\n",
+		name, DEFITER);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct timespec ts;
+	unsigned long nranges;
+	char *p;
+	int opt;
+	int rc;
+
+	while ((opt = getopt(argc, argv, "bhi:r")) != -1) {
+		switch (opt) {
+		case 'b':
+			bulk = 1;
+			break;
+
+		case 'i':
+			niter = strtoul(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'r':
+			report = 1;
+			break;
+
+		case 'h':
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? TEST_OK : TEST_ERR;
+		}
+	}
+
+	if (argc - optind < 1) {
+		usage(argv[0]);
+		return TEST_ERR;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	srand48(ts.tv_nsec);
+
+	rc = TEST_OK;
+	for (; optind < argc && rc == TEST_OK; ++optind) {
+		nranges = strtoul(argv[optind], &p, 0);
+		if (*p || !nranges) {
+			fprintf(stderr, "Invalid number: %s\n", argv[optind]);
+			return TEST_ERR;
+		}
+		rc = run_lookups(nranges);
+	}
+
+	return rc;
+}
@@ -0,0 +1,189 @@
+/* Convert a file into the makedumpfile flattened format.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "testutil.h"
+
+#define MDF_SIGNATURE	"makedumpfile"
+#define MDF_HEADER_SIZE	4096
+
+#define DEFCHUNK	3000
+
+static unsigned long chunksz = DEFCHUNK;
+static int reverse;
+
+static int
+write_be64(FILE *f, int64_t val)
+{
+	uint64_t be = htobe64(val);
+	return fwrite(&be, sizeof be, 1, f) == 1 ? 0 : -1;
+}
+
+static int
+write_record(FILE *f, int64_t offset, const void *data, int64_t size)
+{
+	if (write_be64(f, offset) || write_be64(f, size))
+		return -1;
+	return fwrite(data, 1, size, f) == size ? 0 : -1;
+}
+
+static int
+is_zero(const unsigned char *p, size_t len)
+{
+	while (len--)
+		if (*p++)
+			return 0;
+	return 1;
+}
+
+static int
+flatten(const unsigned char *data, size_t size, FILE *f)
+{
+	unsigned char hdr[MDF_HEADER_SIZE];
+	unsigned char *junk;
+	size_t nchunks, i, idx, off, len;
+
+	memset(hdr, 0, sizeof hdr);
+	strcpy((char *)hdr, MDF_SIGNATURE);
+	*(uint64_t *)(hdr + 16) = htobe64(1);	/* type */
+	*(uint64_t *)(hdr + 24) = htobe64(1);	/* version */
+	if (fwrite(hdr, sizeof hdr, 1, f) != 1)
+		return -1;
+
+	/* Junk inside the first record, overwritten later. */
+	junk = malloc(chunksz);
+	if (!junk)
+		return -1;
+	memset(junk, 0xff, chunksz);
+	len = chunksz / 2;
+	if (chunksz / 4 + len <= size &&
+	    write_record(f, chunksz / 4, junk, len)) {
+		free(junk);
+		return -1;
+	}
+	free(junk);
+
+	nchunks = (size + chunksz - 1) / chunksz;
+	for (i = 0; i < nchunks; ++i) {
+		idx = reverse ? nchunks - 1 - i : i;
+		off = idx * chunksz;
+		len = size - off < chunksz ? size - off : chunksz;
+		/* All-zero chunks are left out (read back as zeroes). */
+		if (is_zero(data + off, len) && off + len < size)
+			continue;
+		if (write_record(f, off, data + off, len))
+			return -1;
+	}
+
+	/* Rewrite the middle of the second record with the same data. */
+	off = chunksz + chunksz / 3;
+	len = chunksz / 3;
+	if (off + len <= size && write_record(f, off, data + off, len))
+		return -1;
+
+	/* End marker */
+	if (write_be64(f, -1) || write_be64(f, -1))
+		return -1;
+	return 0;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [<options>] <input> <output>\n"
+		"\n"
+		"Options:\n"
+		"  -c size    Record size (default: %u)\n"
+		"  -r         Write records in reverse order\n",
+		name, DEFCHUNK);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct blob *blob;
+	FILE *out;
+	char *endp;
+	int opt;
+	int rc;
+
+	while ((opt = getopt(argc, argv, "c:hr")) != -1) {
+		switch (opt) {
+		case 'c':
+			chunksz = strtoul(optarg, &endp, 0);
+			if (endp == optarg || *endp || !chunksz) {
+				fprintf(stderr, "Invalid size: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'r':
+			reverse = 1;
+			break;
+
+		case 'h':
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? TEST_OK : TEST_ERR;
+		}
+	}
+
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		return TEST_ERR;
+	}
+
+	blob = slurp(argv[optind]);
+	if (!blob)
+		return TEST_ERR;
+
+	out = fopen(argv[optind + 1], "w");
+	if (!out) {
+		perror(argv[optind + 1]);
+		free(blob);
+		return TEST_ERR;
+	}
+
+	rc = TEST_OK;
+	if (flatten(blob->data, blob->length, out)) {
+		perror("Cannot write output");
+		rc = TEST_ERR;
+	}
+	if (fclose(out)) {
+		perror("Cannot close output");
+		rc = TEST_ERR;
+	}
+
+	free(blob);
+	return rc;
+}
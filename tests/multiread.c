@@ -43,6 +43,13 @@
 
 static unsigned long base_pfn, npages;
 static unsigned long niter = DEFITER;
+static unsigned long cache_shards;
+static long full_policy = -1;
+static int report;
+static int verify;
+
+/** Error message for a page with unexpected content. */
+static const char bad_content[] = "Unexpected page content";
 
 static void *
 run_reads(void *arg)
@@ -69,11 +76,36 @@ run_reads(void *arg)
 				(unsigned long long) pfn << page_shift);
 			return (void*) kdump_get_err(ctx);
 		}
+		if (verify && (unsigned char)buf[0] != (pfn & 0xff)) {
+			fprintf(stderr, "Page 0x%lx starts with 0x%02x\n",
+				pfn, (unsigned char)buf[0]);
+			return (void*) bad_content;
+		}
 	}
 
 	return NULL;
 }
 
+static kdump_status
+get_cache_stats(kdump_ctx_t *ctx, kdump_num_t *hits, kdump_num_t *misses)
+{
+	kdump_num_t zero;
+	kdump_status res;
+
+	res = kdump_get_number_attr(ctx, "cache.hits", hits);
+	if (res == KDUMP_OK)
+		res = kdump_get_number_attr(ctx, "cache.misses", misses);
+	/* Reads served from the shared zero page bypass the cache. */
+	if (res == KDUMP_OK)
+		res = kdump_get_number_attr(ctx, "cache.zero_pages", &zero);
+	if (res == KDUMP_OK)
+		*hits += zero;
+	if (res != KDUMP_OK)
+		fprintf(stderr, "Cannot get cache statistics: %s\n",
+			kdump_get_err(ctx));
+	return res;
+}
+
 static int
 run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 {
@@ -82,6 +114,8 @@ run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 		kdump_ctx_t *ctx;
 	} tinfo[nthreads];
 	pthread_attr_t attr;
+	struct timespec start, end;
+	kdump_num_t hits, misses, nreads;
 	kdump_attr_t val;
 	kdump_status res;
 	unsigned i;
@@ -98,12 +132,37 @@ run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 		}
 	}
 
+	if (cache_shards) {
+		res = kdump_set_number_attr(ctx, KDUMP_ATTR_CACHE_SHARDS,
+					    cache_shards);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set cache shards: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (full_policy >= 0) {
+		res = kdump_set_number_attr(ctx, KDUMP_ATTR_CACHE_FULL_POLICY,
+					    full_policy);
+		if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot set cache full policy: %s\n",
+				kdump_get_err(ctx));
+			return TEST_ERR;
+		}
+	}
+
+	if (get_cache_stats(ctx, &hits, &misses) != KDUMP_OK)
+		return TEST_ERR;
+	nreads = hits + misses;
+
 	res = pthread_attr_init(&attr);
 	if (res) {
 		fprintf(stderr, "pthread_attr_init: %s\n", strerror(res));
 		return TEST_ERR;
 	}
 
+	clock_gettime(CLOCK_MONOTONIC, &start);
 	for (i = 0; i < nthreads; ++i) {
 		tinfo[i].ctx = kdump_clone(ctx, 0);
 		if (!tinfo[i].ctx) {
@@ -135,6 +194,24 @@ run_threads(kdump_ctx_t *ctx, unsigned long nthreads, unsigned long cache_size)
 		}
 		kdump_free(tinfo[i].ctx);
 	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	if (get_cache_stats(ctx, &hits, &misses) != KDUMP_OK)
+		return TEST_ERR;
+	nreads = hits + misses - nreads;
+	if (rc == TEST_OK && nreads != nthreads * niter) {
+		fprintf(stderr, "Cache statistics mismatch: "
+			"%llu lookups, %lu reads\n",
+			(unsigned long long) nreads, nthreads * niter);
+		rc = TEST_FAIL;
+	}
+
+	if (report && rc == TEST_OK) {
+		double elapsed = (end.tv_sec - start.tv_sec) +
+			(end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("%lu threads: %.0f reads/s\n", nthreads,
+		       nthreads * niter / elapsed);
+	}
 
 	return rc;
 }
@@ -172,8 +249,13 @@ usage(const char *name)
 		"Options:\n"
 		"  -i iterations   Number of reads per thread (default: %u)\n"
 		"  -n num-threads  Number of threads (default: %u)\n"
+		"  -p policy       Cache full policy (0: fail, 1: wait, 2: grow)\n"
+		"  -r              Report total read throughput\n"
 		"  -s cache-size   Cache size\n"
-		"  -t timeout      Maximum execution time in seconds\n",
+		"  -S num-shards   Number of cache shards\n"
+		"  -t timeout      Maximum execution time in seconds\n"
+		"  -v              Verify that each page is filled with\n"
+		"                  its PFN modulo 256\n",
 		name, DEFITER, DEFTHREADS);
 }
 
@@ -190,7 +272,7 @@ main(int argc, char **argv)
 	nthreads = DEFTHREADS;
 	cache_size = 0;
 	timeout = 0;
-	while ((opt = getopt(argc, argv, "hi:n:s:t:")) != -1) {
+	while ((opt = getopt(argc, argv, "hi:n:p:rs:S:t:v")) != -1) {
 		switch (opt) {
 		case 'i':
 			niter = strtoul(optarg, &p, 0);
@@ -208,6 +290,18 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'p':
+			full_policy = strtol(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'r':
+			report = 1;
+			break;
+
 		case 's':
 			cache_size = strtoul(optarg, &p, 0);
 			if (*p) {
@@ -216,6 +310,14 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'S':
+			cache_shards = strtoul(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
 		case 't':
 			timeout = strtoul(optarg, &p, 0);
 			if (*p) {
@@ -224,6 +326,9 @@ main(int argc, char **argv)
 			}
 			break;
 
+		case 'v':
+			verify = 1;
+			break;
 
 		case 'h':
 		default:
@@ -0,0 +1,230 @@
+/* Random PFN lookups in the file page map.
+   Copyright (C) 2016 Petr Tesarik <ptesarik@suse.com>
+
+   This file is free software; you can redistribute it and/or modify
+   it under the terms of either
+
+     * the GNU Lesser General Public License as published by the Free
+       Software Foundation; either version 3 of the License, or (at
+       your option) any later version
+
+   or
+
+     * the GNU General Public License as published by the Free
+       Software Foundation; either version 2 of the License, or (at
+       your option) any later version
+
+   or both in parallel, as here.
+
+   libkdumpfile is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received copies of the GNU General Public License and
+   the GNU Lesser General Public License along with this program.  If
+   not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libkdumpfile/kdumpfile.h>
+
+#include "testutil.h"
+
+#define DEFITER		100000
+
+/* Number of bits checked with kdump_bmp_get_bits(). */
+#define SPAN		64
+
+static unsigned long niter = DEFITER;
+static int report;
+
+/* Check that the result of find_set is consistent with get_bits. */
+static int
+check_lookup(kdump_bmp_t *bmp, kdump_addr_t pfn, kdump_addr_t found)
+{
+	unsigned char bits[SPAN / 8];
+	kdump_addr_t i;
+	kdump_status res;
+
+	res = kdump_bmp_get_bits(bmp, pfn, pfn + SPAN - 1, bits);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot get bits at 0x%llx: %s\n",
+			(unsigned long long) pfn, kdump_bmp_get_err(bmp));
+		return TEST_ERR;
+	}
+
+	for (i = 0; i < SPAN && pfn + i <= found; ++i) {
+		int isset = !!(bits[i / 8] & (1U << (i % 8)));
+		if (isset != (pfn + i == found)) {
+			fprintf(stderr, "Mismatch at 0x%llx: find_set"
+				" from 0x%llx returned 0x%llx\n",
+				(unsigned long long) (pfn + i),
+				(unsigned long long) pfn,
+				(unsigned long long) found);
+			return TEST_FAIL;
+		}
+	}
+
+	return TEST_OK;
+}
+
+static int
+run_lookups(kdump_ctx_t *ctx, unsigned long npages)
+{
+	struct timespec start, end;
+	kdump_attr_t attr;
+	kdump_bmp_t *bmp;
+	kdump_addr_t pfn, found;
+	kdump_status res;
+	unsigned long i, nfound;
+	int rc;
+
+	res = kdump_get_attr(ctx, KDUMP_ATTR_FILE_PAGEMAP, &attr);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot get file page map: %s\n",
+			kdump_get_err(ctx));
+		return TEST_ERR;
+	}
+	bmp = attr.val.bitmap;
+
+	/* Timed lookups. */
+	nfound = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < niter; ++i) {
+		found = lrand48() % npages;
+		if (kdump_bmp_find_set(bmp, &found) == KDUMP_OK)
+			++nfound;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	/* Verify a sample of lookups. */
+	rc = TEST_OK;
+	for (i = 0; i < niter / 16 && rc == TEST_OK; ++i) {
+		pfn = lrand48() % npages;
+		found = pfn;
+		res = kdump_bmp_find_set(bmp, &found);
+		if (res == KDUMP_ERR_NODATA)
+			found = ~(kdump_addr_t)0;
+		else if (res != KDUMP_OK) {
+			fprintf(stderr, "Cannot find set bit from 0x%llx: %s\n",
+				(unsigned long long) pfn,
+				kdump_bmp_get_err(bmp));
+			rc = TEST_ERR;
+			break;
+		}
+		rc = check_lookup(bmp, pfn, found);
+	}
+
+	if (report && rc == TEST_OK) {
+		double elapsed = (end.tv_sec - start.tv_sec) +
+			(end.tv_nsec - start.tv_nsec) / 1e9;
+		printf("%lu lookups (%lu found): %.0f lookups/s\n",
+		       niter, nfound, niter / elapsed);
+	}
+
+	return rc;
+}
+
+static int
+run_lookups_fd(int fd, unsigned long npages)
+{
+	kdump_ctx_t *ctx;
+	kdump_status res;
+	int rc;
+
+	ctx = kdump_new();
+	if (!ctx) {
+		perror("Cannot initialize dump context");
+		return TEST_ERR;
+	}
+
+	res = kdump_set_number_attr(ctx, KDUMP_ATTR_FILE_FD, fd);
+	if (res != KDUMP_OK) {
+		fprintf(stderr, "Cannot open dump: %s\n", kdump_get_err(ctx));
+		rc = TEST_ERR;
+	} else
+		rc = run_lookups(ctx, npages);
+
+	kdump_free(ctx);
+	return rc;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [<options>] <dump> <num-pages>\n"
+		"\n"
+		"Options:\n"
+		"  -i iterations   Number of lookups (default: %u)\n"
+		"  -r              Report lookup throughput\n",
+		name, DEFITER);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct timespec ts;
+	unsigned long npages;
+	char *p;
+	int opt;
+	int fd;
+	int rc;
+
+	while ((opt = getopt(argc, argv, "hi:r")) != -1) {
+		switch (opt) {
+		case 'i':
+			niter = strtoul(optarg, &p, 0);
+			if (*p) {
+				fprintf(stderr, "Invalid number: %s\n", optarg);
+				return TEST_ERR;
+			}
+			break;
+
+		case 'r':
+			report = 1;
+			break;
+
+		case 'h':
+		default:
+			usage(argv[0]);
+			return (opt == 'h') ? TEST_OK : TEST_ERR;
+		}
+	}
+
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		return TEST_ERR;
+	}
+
+	npages = strtoul(argv[optind+1], &p, 0);
+	if (*p || !npages) {
+		fprintf(stderr, "Invalid number: %s\n", argv[optind+1]);
+		return TEST_ERR;
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0) {
+		perror("open dump");
+		return TEST_ERR;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	srand48(ts.tv_nsec);
+
+	rc = run_lookups_fd(fd, npages);
+
+	if (close(fd) < 0) {
+		perror("close dump");
+		rc = TEST_ERR;
+	}
+
+	return rc;
+}
@@ -29,6 +29,7 @@
 #define _GNU_SOURCE
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include <libkdumpfile/addrxlat.h>
 
@@ -196,6 +197,41 @@ static struct test test_nomach[] = {
 	  ADDRXLAT_CAPS(ADDRXLAT_KVADDR) |
 	  ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR)
 	},
+
+	/* Translated to machphys before the map was changed. */
+	{ FULLADDR(KPHYSADDR, 0x6543),
+	  FULLADDR(KVADDR, 0x10006543),
+	  ADDRXLAT_CAPS(ADDRXLAT_KVADDR) |
+	  ADDRXLAT_CAPS(ADDRXLAT_MACHPHYSADDR)
+	},
+};
+
+/* Page tables for the block tests (x86_64 4-level paging). */
+static const struct pte {
+	addrxlat_addr_t addr;
+	uint64_t val;
+} ptes[] = {
+	{ 0x1000, 0x2067 },	/* PGD[0] -> 2000 */
+	{ 0x2000, 0x3067 },	/* PGD[0] -> PUD[0] -> 3000 */
+	{ 0x3000, 0x4067 },	/* PGD[0] -> PUD[0] -> PMD[0] -> 4000 */
+	{ 0x3008, 0xe000e7 },	/* PGD[0] -> PUD[0] -> PMD[1] (2M) */
+	{ 0x4008, 0xb067 },	/* PGD[0] -> PUD[0] -> PMD[0] -> PTE[1] */
+};
+
+struct block_test {
+	addrxlat_addr_t addr;
+	addrxlat_addr_t expect;
+	addrxlat_addr_t below;
+	addrxlat_addr_t above;
+};
+
+static const struct block_test block_tests[] = {
+	/* 4K page */
+	{ 0x1234, 0xb234, 0x234, 0xdcb },
+	/* 2M page */
+	{ 0x212345, 0xe12345, 0x12345, 0x1edcba },
+	/* Linear mapping, clipped by the map range */
+	{ 0x3fff1234, 0xbb234, 0x1234, 0xedcb },
 };
 
 static void
@@ -288,6 +324,155 @@ test_one(addrxlat_op_ctl_t *ctl, const struct test *test)
 	return TEST_ERR;
 }
 
+static addrxlat_status
+get_pte_page(void *data, addrxlat_buffer_t *buf)
+{
+	addrxlat_ctx_t *ctx = data;
+	unsigned i;
+
+	for (i = 0; i < ARRAY_SIZE(ptes); ++i)
+		if (ptes[i].addr == buf->addr.addr) {
+			buf->ptr = &ptes[i].val;
+			buf->size = sizeof ptes[i].val;
+			buf->byte_order = ADDRXLAT_LITTLE_ENDIAN;
+			return ADDRXLAT_OK;
+		}
+	return addrxlat_ctx_err(ctx, ADDRXLAT_ERR_NODATA, "No data");
+}
+
+static addrxlat_status
+storeop(void *data, const addrxlat_fulladdr_t *addr)
+{
+	*(addrxlat_fulladdr_t*)data = *addr;
+	return ADDRXLAT_OK;
+}
+
+static int
+test_block(addrxlat_op_ctl_t *ctl, const struct block_test *test)
+{
+	addrxlat_fulladdr_t addr, result;
+	addrxlat_addr_t below, above;
+	addrxlat_status status;
+
+	printf("KVADDR:0x%"ADDRXLAT_PRIxADDR" expect KPHYSADDR:0x%"
+	       ADDRXLAT_PRIxADDR" -0x%"ADDRXLAT_PRIxADDR
+	       " +0x%"ADDRXLAT_PRIxADDR,
+	       test->addr, test->expect, test->below, test->above);
+
+	ctl->data = &result;
+	addr.as = ADDRXLAT_KVADDR;
+	addr.addr = test->addr;
+	status = addrxlat_op_block(ctl, &addr, &below, &above);
+	if (status != ADDRXLAT_OK) {
+		puts(": ERR");
+		fprintf(stderr, "addrxlat_op_block failed: %s\n",
+			addrxlat_ctx_get_err(ctl->ctx));
+		return TEST_ERR;
+	}
+
+	printf(" actual ");
+	print_fulladdr(&result);
+	printf(" -0x%"ADDRXLAT_PRIxADDR" +0x%"ADDRXLAT_PRIxADDR,
+	       below, above);
+	if (result.as != ADDRXLAT_KPHYSADDR ||
+	    result.addr != test->expect ||
+	    below != test->below || above != test->above) {
+		puts(": FAIL");
+		return TEST_FAIL;
+	}
+	puts(": OK");
+	return TEST_OK;
+}
+
+/** Run translation block tests.
+ * @param ctx      Translation context.
+ * @param nrounds  Number of times each test is run.
+ * @returns        Test status.
+ */
+static int
+run_block_tests(addrxlat_ctx_t *ctx, unsigned nrounds)
+{
+	addrxlat_cb_t cb = {
+		.data = ctx,
+		.get_page = get_pte_page,
+		.read_caps = ADDRXLAT_CAPS(ADDRXLAT_KPHYSADDR),
+	};
+	addrxlat_sys_t *sys;
+	addrxlat_map_t *map;
+	addrxlat_range_t range;
+	addrxlat_meth_t meth;
+	addrxlat_op_ctl_t ctl;
+	addrxlat_status status;
+	unsigned round;
+	int i;
+	int tmp, ret;
+
+	addrxlat_ctx_set_cb(ctx, &cb);
+
+	sys = addrxlat_sys_new();
+	if (!sys) {
+		fputs("Cannot allocate translation system", stderr);
+		return TEST_ERR;
+	}
+
+	meth.kind = ADDRXLAT_PGT;
+	meth.target_as = ADDRXLAT_KPHYSADDR;
+	meth.param.pgt.root.as = ADDRXLAT_KPHYSADDR;
+	meth.param.pgt.root.addr = 0x1000;
+	meth.param.pgt.pte_mask = 0;
+	meth.param.pgt.pf.pte_format = ADDRXLAT_PTE_X86_64;
+	meth.param.pgt.pf.nfields = 5;
+	meth.param.pgt.pf.fieldsz[0] = 12;
+	meth.param.pgt.pf.fieldsz[1] = 9;
+	meth.param.pgt.pf.fieldsz[2] = 9;
+	meth.param.pgt.pf.fieldsz[3] = 9;
+	meth.param.pgt.pf.fieldsz[4] = 9;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_PGT, &meth);
+
+	map = addrxlat_map_new();
+	if (!map) {
+		perror("Cannot allocate virt-to-phys map");
+		return TEST_ERR;
+	}
+	range.endoff = 0x3fffffff;
+	range.meth = ADDRXLAT_SYS_METH_PGT;
+	status = addrxlat_map_set(map, 0, &range);
+	if (status == ADDRXLAT_OK) {
+		/* Linear mapping at the end of the range. */
+		range.endoff = 0xffff;
+		range.meth = ADDRXLAT_SYS_METH_DIRECT;
+		status = addrxlat_map_set(map, 0x3fff0000, &range);
+	}
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot update virt-to-phys map: %s\n",
+			addrxlat_strerror(status));
+		return TEST_ERR;
+	}
+	addrxlat_sys_set_map(sys, ADDRXLAT_SYS_MAP_KV_PHYS, map);
+	addrxlat_map_decref(map);
+
+	meth.kind = ADDRXLAT_LINEAR;
+	meth.target_as = ADDRXLAT_KPHYSADDR;
+	meth.param.linear.off = 0xbb234 - 0x3fff1234;
+	addrxlat_sys_set_meth(sys, ADDRXLAT_SYS_METH_DIRECT, &meth);
+
+	ctl.ctx = ctx;
+	ctl.sys = sys;
+	ctl.op = storeop;
+	ctl.caps = ADDRXLAT_CAPS(ADDRXLAT_KPHYSADDR);
+
+	ret = TEST_OK;
+	for (round = 0; round < nrounds; ++round)
+		for (i = 0; i < ARRAY_SIZE(block_tests); ++i) {
+			tmp = test_block(&ctl, &block_tests[i]);
+			if (tmp > ret)
+				ret = tmp;
+		}
+
+	addrxlat_sys_decref(sys);
+	return ret;
+}
+
 static int
 unmap(addrxlat_ctx_t *ctx, addrxlat_sys_t *sys,
       addrxlat_sys_map_t mapidx, addrxlat_addr_t addr,
@@ -307,6 +492,9 @@ unmap(addrxlat_ctx_t *ctx, addrxlat_sys_t *sys,
 		return TEST_ERR;
 	}
 
+	/* Install the map again to discard cached translations. */
+	addrxlat_sys_set_map(sys, mapidx, map);
+
 	return TEST_OK;
 }
 
@@ -419,21 +607,40 @@ setup_linear_maps(addrxlat_ctx_t *ctx, addrxlat_sys_t *sys)
 	return TEST_OK;
 }
 
-int
-main(int argc, char **argv)
+/** Run all tests.
+ * @param cache_size  Size of the translation cache.
+ * @returns           Test status.
+ *
+ * If the translation cache is enabled, all translations are done
+ * twice, so the second round uses cached translations.
+ */
+static int
+run_tests(size_t cache_size)
 {
 	addrxlat_ctx_t *ctx;
 	addrxlat_sys_t *sys;
 	addrxlat_op_ctl_t ctl;
+	addrxlat_status status;
+	unsigned round, nrounds;
 	int i;
 	int tmp, ret;
 
+	printf("Translation cache size: %zu\n", cache_size);
+
 	ctx = addrxlat_ctx_new();
 	if (!ctx) {
 		fputs("Cannot allocate translation context", stderr);
 		return TEST_ERR;
 	}
 
+	status = addrxlat_ctx_set_xlat_cache(ctx, cache_size);
+	if (status != ADDRXLAT_OK) {
+		fprintf(stderr, "Cannot set translation cache: %s\n",
+			addrxlat_ctx_get_err(ctx));
+		return TEST_ERR;
+	}
+	nrounds = cache_size ? 2 : 1;
+
 	sys = addrxlat_sys_new();
 	if (!sys) {
 		fputs("Cannot allocate translation system", stderr);
@@ -449,11 +656,12 @@ main(int argc, char **argv)
 	ctl.op = testop;
 
 	ret = TEST_OK;
-	for (i = 0; i < ARRAY_SIZE(tests); ++i) {
-		tmp = test_one(&ctl, &tests[i]);
-		if (tmp > ret)
-			ret = tmp;
-	}
+	for (round = 0; round < nrounds; ++round)
+		for (i = 0; i < ARRAY_SIZE(tests); ++i) {
+			tmp = test_one(&ctl, &tests[i]);
+			if (tmp > ret)
+				ret = tmp;
+		}
 
 	/* Remove kphys->machphys 0-0xffff. */
 	tmp = unmap(ctx, sys, ADDRXLAT_SYS_MAP_KPHYS_MACHPHYS,
@@ -461,14 +669,33 @@ main(int argc, char **argv)
 	if (tmp > ret)
 		ret = tmp;
 
-	for (i = 0; i < ARRAY_SIZE(test_nomach); ++i) {
-		tmp = test_one(&ctl, &test_nomach[i]);
-		if (tmp > ret)
-			ret = tmp;
-	}
+	for (round = 0; round < nrounds; ++round)
+		for (i = 0; i < ARRAY_SIZE(test_nomach); ++i) {
+			tmp = test_one(&ctl, &test_nomach[i]);
+			if (tmp > ret)
+				ret = tmp;
+		}
 
 	addrxlat_sys_decref(sys);
+
+	tmp = run_block_tests(ctx, nrounds);
+	if (tmp > ret)
+		ret = tmp;
+
 	addrxlat_ctx_decref(ctx);
 
 	return ret;
 }
+
+int
+main(int argc, char **argv)
+{
+	int tmp, ret;
+
+	ret = run_tests(0);
+	tmp = run_tests(64);
+	if (tmp > ret)
+		ret = tmp;
+
+	return ret;
+}